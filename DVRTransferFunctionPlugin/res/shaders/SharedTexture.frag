@@ -0,0 +1,22 @@
+#version 330 core
+
+// Converts the shapes painted by QPainter into the layout of the shared textures.
+// The paint engine blends premultiplied colors, the transfer function texture holds straight alpha like the QImage path.
+// The material ID map holds the ID (the red channel of the painted color) as a float, like the material position dataset.
+
+uniform sampler2D source;       // The framebuffer QPainter painted the shapes into, it has the size of the target texture
+uniform bool materialIDs;       // Write the material ID instead of the color
+
+out vec4 fragColor;
+
+void main()
+{
+    vec4 color = texelFetch(source, ivec2(gl_FragCoord.xy), 0);
+
+    if (materialIDs) {
+        fragColor = vec4(floor(color.r * 255.0 + 0.5), 0.0, 0.0, 1.0);
+        return;
+    }
+
+    fragColor = color.a > 0.0 ? vec4(color.rgb / color.a, color.a) : vec4(0.0);
+}
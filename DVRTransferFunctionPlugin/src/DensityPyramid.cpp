@@ -0,0 +1,139 @@
+#include "DensityPyramid.h"
+
+#include <QColor>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+void DensityPyramid::build(const std::vector<mv::Vector2f>& points, const QRectF& dataBounds, int baseResolution)
+{
+    clear();
+
+    if (points.empty() || dataBounds.width() <= 0 || dataBounds.height() <= 0 || baseResolution <= 0)
+        return;
+
+    // A power of two makes every level exactly half of the previous one
+    int resolution = 1;
+    while (resolution < baseResolution)
+        resolution *= 2;
+
+    _dataBounds = dataBounds;
+
+    Level base;
+    base.resolution = resolution;
+    base.counts.assign(static_cast<size_t>(resolution) * resolution, 0);
+
+    const float left = static_cast<float>(dataBounds.left());
+    const float bottom = static_cast<float>(dataBounds.top());
+    const float scaleX = resolution / static_cast<float>(dataBounds.width());
+    const float scaleY = resolution / static_cast<float>(dataBounds.height());
+    const float maxCell = static_cast<float>(resolution - 1);
+    const std::int64_t numPoints = static_cast<std::int64_t>(points.size());
+    std::uint32_t* counts = base.counts.data();
+
+    // The points are spread over the whole grid, so collisions of the atomic increments are rare.
+    // Private histograms per thread would need the full grid per thread, which does not fit in the caches either.
+    #pragma omp parallel for schedule(static)
+    for (std::int64_t i = 0; i < numPoints; i++) {
+        // Converting a NaN to an int is undefined, points without a valid position are not counted
+        if (!std::isfinite(points[i].x) || !std::isfinite(points[i].y))
+            continue;
+
+        const int x = static_cast<int>(std::clamp((points[i].x - left) * scaleX, 0.0f, maxCell));
+        const int y = static_cast<int>(std::clamp((points[i].y - bottom) * scaleY, 0.0f, maxCell));
+
+        #pragma omp atomic
+        counts[static_cast<size_t>(y) * resolution + x]++;
+    }
+
+    base.maxCount = *std::max_element(base.counts.begin(), base.counts.end());
+    _levels.push_back(std::move(base));
+
+    // Every cell of a coarser level is the sum of 2x2 cells of the finer one
+    while (_levels.back().resolution > 1) {
+        const Level& finer = _levels.back();
+        Level coarser;
+        coarser.resolution = finer.resolution / 2;
+        coarser.counts.resize(static_cast<size_t>(coarser.resolution) * coarser.resolution);
+
+        const int coarserResolution = coarser.resolution;
+        const int finerResolution = finer.resolution;
+        const std::uint32_t* finerCounts = finer.counts.data();
+        std::uint32_t* coarserCounts = coarser.counts.data();
+
+        #pragma omp parallel for schedule(static) if (coarserResolution >= 64)
+        for (int y = 0; y < coarserResolution; y++) {
+            const std::uint32_t* row0 = finerCounts + static_cast<size_t>(2 * y) * finerResolution;
+            const std::uint32_t* row1 = row0 + finerResolution;
+            std::uint32_t* target = coarserCounts + static_cast<size_t>(y) * coarserResolution;
+
+            for (int x = 0; x < coarserResolution; x++)
+                target[x] = row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1];
+        }
+
+        coarser.maxCount = *std::max_element(coarser.counts.begin(), coarser.counts.end());
+        _levels.push_back(std::move(coarser));
+    }
+
+    _images.resize(_levels.size());
+}
+
+void DensityPyramid::clear()
+{
+    _levels.clear();
+    _images.clear();
+    _dataBounds = QRectF();
+}
+
+int DensityPyramid::selectLevel(double screenSize) const
+{
+    if (_levels.empty() || screenSize > _levels.front().resolution)
+        return -1;
+
+    // The levels halve the resolution, so the coarsest one that still has a cell per pixel is found by walking up
+    int level = 0;
+    while (level + 1 < getNumberOfLevels() && _levels[level + 1].resolution >= screenSize)
+        level++;
+
+    return level;
+}
+
+const QImage& DensityPyramid::getImage(int level, const QColor& color)
+{
+    // The cached images only hold for one color
+    if (color.rgba() != _imageColor) {
+        std::fill(_images.begin(), _images.end(), QImage());
+        _imageColor = color.rgba();
+    }
+
+    QImage& image = _images[level];
+    if (!image.isNull())
+        return image;
+
+    const Level& source = _levels[level];
+    image = QImage(source.resolution, source.resolution, QImage::Format_ARGB32_Premultiplied);
+
+    const float logMax = std::log1p(static_cast<float>(source.maxCount));
+    const float colorAlpha = color.alphaF();
+    uchar* bits = image.bits();     // Detaches here once, not in every thread
+    const qsizetype bytesPerLine = image.bytesPerLine();
+
+    #pragma omp parallel for schedule(static) if (source.resolution >= 256)
+    for (int y = 0; y < source.resolution; y++) {
+        // The screen has its first row at the top, the levels at the bottom
+        const std::uint32_t* counts = source.counts.data() + static_cast<size_t>(source.resolution - 1 - y) * source.resolution;
+        QRgb* target = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+
+        for (int x = 0; x < source.resolution; x++) {
+            const float density = logMax > 0.0f ? std::log1p(static_cast<float>(counts[x])) / logMax : 0.0f;
+            const int alpha = static_cast<int>(density * colorAlpha * 255.0f + 0.5f);
+            target[x] = qPremultiply(qRgba(color.red(), color.green(), color.blue(), alpha));
+        }
+    }
+
+    return image;
+}
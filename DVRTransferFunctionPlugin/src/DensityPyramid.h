@@ -0,0 +1,67 @@
+#pragma once
+
+#include <graphics/Vector2f.h>
+
+#include <QColor>
+#include <QImage>
+#include <QRectF>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Multi-resolution 2D histogram of the embedding, used to draw the distribution of very large point sets instead of the points.
+ *
+ * Level 0 counts the points in a grid of baseResolution x baseResolution cells over the data bounds, every next level sums
+ * 2x2 cells of the previous one. The level whose cells are about one screen pixel is drawn, so the cost of a repaint only
+ * depends on the size of the window and not on the number of points. Row 0 of every level is the bottom of the data bounds.
+ */
+class DensityPyramid
+{
+public:
+    struct Level {
+        int                         resolution = 0;     // Width and height in cells
+        std::vector<std::uint32_t>  counts;             // Number of points per cell, row by row
+        std::uint32_t               maxCount = 0;       // Largest count of the level, for the normalization of the image
+    };
+
+    /**
+     * Counts the points into the base level and builds the coarser levels, in parallel when OpenMP is available
+     * @param points Positions of the points
+     * @param dataBounds Bounds of the points (left, bottom, width, height) the grid is spread over
+     * @param baseResolution Resolution of the finest level, rounded up to a power of two
+     */
+    void build(const std::vector<mv::Vector2f>& points, const QRectF& dataBounds, int baseResolution = 1024);
+
+    /** Removes all levels */
+    void clear();
+
+    bool isEmpty() const { return _levels.empty(); }
+
+    const QRectF& getDataBounds() const { return _dataBounds; }
+
+    int getNumberOfLevels() const { return static_cast<int>(_levels.size()); }
+
+    const Level& getLevel(int level) const { return _levels[level]; }
+
+    /**
+     * Coarsest level whose cells are at most one pixel when the data bounds cover the given number of screen pixels
+     * @param screenSize Size of the data bounds on the screen in pixels (the larger of width and height)
+     * @return The level, or -1 when even the cells of the base level are larger than a pixel (the points should be drawn then)
+     */
+    int selectLevel(double screenSize) const;
+
+    /**
+     * Density image of a level, made on first use and kept until the next build
+     * @param level Level of the image
+     * @param color Color of the points, the density is mapped to its alpha (logarithmically, so sparse regions stay visible)
+     * @return ARGB32 premultiplied image with the top row of the data bounds as the first row, like the screen
+     */
+    const QImage& getImage(int level, const QColor& color);
+
+private:
+    QRectF              _dataBounds;
+    std::vector<Level>  _levels;
+    std::vector<QImage> _images;        // Cached density image per level, null when not made yet
+    QRgb                _imageColor = 0;
+};
@@ -0,0 +1,129 @@
+#include "EmbeddingGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+void EmbeddingGrid::build(const std::vector<mv::Vector2f>& points, const QRectF& dataBounds, int pointsPerCell)
+{
+    clear();
+
+    if (points.empty() || dataBounds.width() <= 0 || dataBounds.height() <= 0)
+        return;
+
+    _points = &points;
+    _dataBounds = dataBounds;
+
+    // Square cells (in embedding units) with about pointsPerCell points each when the points were spread evenly
+    const double numCells = std::max(1.0, static_cast<double>(points.size()) / std::max(1, pointsPerCell));
+    const double cellSize = std::sqrt(dataBounds.width() * dataBounds.height() / numCells);
+    _resolutionX = std::clamp(static_cast<int>(std::ceil(dataBounds.width() / cellSize)), 1, 4096);
+    _resolutionY = std::clamp(static_cast<int>(std::ceil(dataBounds.height() / cellSize)), 1, 4096);
+    _cellsPerUnitX = static_cast<float>(_resolutionX / dataBounds.width());
+    _cellsPerUnitY = static_cast<float>(_resolutionY / dataBounds.height());
+
+    const std::size_t numGridCells = static_cast<std::size_t>(_resolutionX) * _resolutionY;
+
+    // Counting sort: count the points per cell, turn the counts into start offsets and scatter the indices
+    // Points with a non-finite position are left out of the grid, no query can contain them
+    constexpr std::uint32_t noCell = std::numeric_limits<std::uint32_t>::max();
+
+    std::vector<std::uint32_t> pointCells(points.size(), noCell);
+    std::size_t numFinitePoints = 0;
+    _cellStarts.assign(numGridCells + 1, 0);
+
+    for (std::size_t i = 0; i < points.size(); i++) {
+        if (!std::isfinite(points[i].x) || !std::isfinite(points[i].y))
+            continue;
+
+        const std::uint32_t cell = static_cast<std::uint32_t>(cellY(points[i].y)) * _resolutionX + cellX(points[i].x);
+        pointCells[i] = cell;
+        _cellStarts[cell + 1]++;
+        numFinitePoints++;
+    }
+
+    for (std::size_t cell = 0; cell < numGridCells; cell++)
+        _cellStarts[cell + 1] += _cellStarts[cell];
+
+    std::vector<std::uint32_t> fill(_cellStarts.begin(), _cellStarts.end() - 1);
+    _pointIndices.resize(numFinitePoints);
+
+    for (std::size_t i = 0; i < points.size(); i++)
+        if (pointCells[i] != noCell)
+            _pointIndices[fill[pointCells[i]]++] = static_cast<std::uint32_t>(i);
+}
+
+void EmbeddingGrid::clear()
+{
+    _points = nullptr;
+    _dataBounds = QRectF();
+    _resolutionX = 0;
+    _resolutionY = 0;
+    _cellStarts.clear();
+    _pointIndices.clear();
+}
+
+int EmbeddingGrid::cellX(float x) const
+{
+    const float cell = (x - static_cast<float>(_dataBounds.left())) * _cellsPerUnitX;
+
+    // Written so a NaN ends up in the first cell instead of being cast to an int
+    return cell >= 0.0f ? static_cast<int>(std::min(cell, static_cast<float>(_resolutionX - 1))) : 0;
+}
+
+int EmbeddingGrid::cellY(float y) const
+{
+    const float cell = (y - static_cast<float>(_dataBounds.top())) * _cellsPerUnitY;
+
+    return cell >= 0.0f ? static_cast<int>(std::min(cell, static_cast<float>(_resolutionY - 1))) : 0;
+}
+
+void EmbeddingGrid::queryRect(const QRectF& rect, std::vector<std::uint32_t>& indices, const std::function<bool(const mv::Vector2f&)>& accept) const
+{
+    if (isEmpty())
+        return;
+
+    const std::vector<mv::Vector2f>& points = *_points;
+
+    // QRectF is used with the y axis up here, so top() is the smallest y
+    const float left = static_cast<float>(rect.left());
+    const float right = static_cast<float>(rect.right());
+    const float bottom = static_cast<float>(rect.top());
+    const float top = static_cast<float>(rect.bottom());
+
+    const int firstX = cellX(left), lastX = cellX(right);
+    const int firstY = cellY(bottom), lastY = cellY(top);
+
+    for (int y = firstY; y <= lastY; y++) {
+        for (int x = firstX; x <= lastX; x++) {
+            const std::size_t cell = static_cast<std::size_t>(y) * _resolutionX + x;
+
+            // Only the cells on the border of the rectangle can hold points outside of it
+            const bool interior = x > firstX && x < lastX && y > firstY && y < lastY;
+
+            for (std::uint32_t entry = _cellStarts[cell]; entry < _cellStarts[cell + 1]; entry++) {
+                const std::uint32_t index = _pointIndices[entry];
+                const mv::Vector2f& point = points[index];
+
+                if (!interior && (point.x < left || point.x > right || point.y < bottom || point.y > top))
+                    continue;
+
+                if (accept && !accept(point))
+                    continue;
+
+                indices.push_back(index);
+            }
+        }
+    }
+}
+
+void EmbeddingGrid::queryRadius(const mv::Vector2f& center, float radius, std::vector<std::uint32_t>& indices) const
+{
+    const float radiusSquared = radius * radius;
+
+    queryRect(QRectF(center.x - radius, center.y - radius, 2 * radius, 2 * radius), indices, [&center, radiusSquared](const mv::Vector2f& point) {
+        const float dx = point.x - center.x;
+        const float dy = point.y - center.y;
+        return dx * dx + dy * dy <= radiusSquared;
+    });
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <graphics/Vector2f.h>
+
+#include <QRectF>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * Uniform grid over the 2D embedding, so region queries only visit the points of the cells that overlap the region.
+ *
+ * The point indices are sorted by cell (a counting sort, stored like a compressed sparse row matrix): the points of
+ * cell c are _pointIndices[_cellStarts[c]] up to _pointIndices[_cellStarts[c + 1]]. The grid is sized for a few
+ * points per cell on average, so a query costs about the number of points in the region plus its boundary cells.
+ */
+class EmbeddingGrid
+{
+public:
+    /**
+     * Sorts the points into the grid
+     * @param points Positions of the points, the indices of the queries refer to this vector
+     * @param dataBounds Bounds of the points (left, bottom, width, height)
+     * @param pointsPerCell Average number of points per cell the grid resolution is chosen for
+     */
+    void build(const std::vector<mv::Vector2f>& points, const QRectF& dataBounds, int pointsPerCell = 8);
+
+    void clear();
+
+    bool isEmpty() const { return _pointIndices.empty(); }
+
+    /**
+     * Collects the points inside a rectangle of the embedding
+     * @param rect Rectangle in embedding coordinates (left, bottom, width, height)
+     * @param indices Receives the indices of the points inside the rectangle (appended)
+     * @param accept Optional exact test for the points in the rectangle, e.g. the outline of a shape
+     */
+    void queryRect(const QRectF& rect, std::vector<std::uint32_t>& indices, const std::function<bool(const mv::Vector2f&)>& accept = {}) const;
+
+    /**
+     * Collects the points within a distance of a position of the embedding
+     * @param center Position in embedding coordinates
+     * @param radius Distance in embedding coordinates
+     * @param indices Receives the indices of the points within the radius (appended)
+     */
+    void queryRadius(const mv::Vector2f& center, float radius, std::vector<std::uint32_t>& indices) const;
+
+private:
+    int cellX(float x) const;
+    int cellY(float y) const;
+
+private:
+    const std::vector<mv::Vector2f>*    _points = nullptr;  // Positions the grid was built from, owned by the plugin
+    QRectF                              _dataBounds;
+    int                                 _resolutionX = 0;
+    int                                 _resolutionY = 0;
+    float                               _cellsPerUnitX = 0.0f;
+    float                               _cellsPerUnitY = 0.0f;
+    std::vector<std::uint32_t>          _cellStarts;        // First entry of every cell in _pointIndices, one extra entry at the end
+    std::vector<std::uint32_t>          _pointIndices;      // Point indices sorted by cell
+};
@@ -0,0 +1,244 @@
+#include "EmbeddingStatistics.h"
+
+#include <QDebug>
+#include <QImage>
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+void EmbeddingStatistics::build(const std::vector<mv::Vector2f>& positions, const QRectF& dataBounds, const QStringList& channelNames,
+                                const std::function<bool(int channel, std::vector<float>& values)>& loadChannel, int resolution, const std::atomic<bool>* cancelled)
+{
+    clear();
+
+    if (positions.empty() || dataBounds.width() <= 0 || dataBounds.height() <= 0 || resolution <= 0)
+        return;
+
+    const std::int64_t numPoints = static_cast<std::int64_t>(positions.size());
+    const std::size_t numCells = static_cast<std::size_t>(resolution) * resolution;
+    const float left = static_cast<float>(dataBounds.left());
+    const float bottom = static_cast<float>(dataBounds.top());
+    const float scaleX = resolution / static_cast<float>(dataBounds.width());
+    const float scaleY = resolution / static_cast<float>(dataBounds.height());
+    const float maxCell = static_cast<float>(resolution - 1);
+
+    // Same binning as the density pyramid, row 0 is the bottom of the data bounds, non-finite positions are left out
+    auto isFinite = [](const mv::Vector2f& position) -> bool {
+        return std::isfinite(position.x) && std::isfinite(position.y);
+    };
+
+    auto cellOf = [&](const mv::Vector2f& position) -> std::size_t {
+        const int x = static_cast<int>(std::clamp((position.x - left) * scaleX, 0.0f, maxCell));
+        const int y = static_cast<int>(std::clamp((position.y - bottom) * scaleY, 0.0f, maxCell));
+        return static_cast<std::size_t>(y) * resolution + x;
+    };
+
+    _resolution = resolution;
+
+    std::vector<double> counts(numCells, 0.0);
+    for (const auto& position : positions)
+        if (isFinite(position))
+            counts[cellOf(position)] += 1.0;
+    _countTable = summedAreaTable(counts);
+
+    // The channels are loaded one at a time, so only one value per voxel has to be in memory at once
+    std::vector<float> values;
+    for (int channel = 0; channel < channelNames.size(); channel++) {
+        if (cancelled && *cancelled) {
+            clear();
+            return;
+        }
+
+        values.clear();
+        if (!loadChannel(channel, values) || static_cast<std::int64_t>(values.size()) != numPoints) {
+            qCritical() << "EmbeddingStatistics: could not load the values of channel" << channelNames[channel] << ", the statistics stop at the channels before it";
+            break;
+        }
+
+        std::vector<double> sums(numCells, 0.0);
+        std::vector<double> sumsSquared(numCells, 0.0);
+
+        // Every thread bins into its own grid (2 x resolution^2 doubles), the grids are added up at the end
+        #pragma omp parallel
+        {
+            std::vector<double> threadSums(numCells, 0.0);
+            std::vector<double> threadSumsSquared(numCells, 0.0);
+
+            #pragma omp for schedule(static)
+            for (std::int64_t i = 0; i < numPoints; i++) {
+                if (!isFinite(positions[i]))
+                    continue;
+
+                const std::size_t cell = cellOf(positions[i]);
+                const double value = values[i];
+                threadSums[cell] += value;
+                threadSumsSquared[cell] += value * value;
+            }
+
+            #pragma omp critical
+            {
+                for (std::size_t cell = 0; cell < numCells; cell++) {
+                    sums[cell] += threadSums[cell];
+                    sumsSquared[cell] += threadSumsSquared[cell];
+                }
+            }
+        }
+
+        _sumTables.push_back(summedAreaTable(sums));
+        _sumSquaredTables.push_back(summedAreaTable(sumsSquared));
+        _channelNames << channelNames[channel];
+    }
+}
+
+void EmbeddingStatistics::clear()
+{
+    _resolution = 0;
+    _channelNames.clear();
+    _countTable.clear();
+    _sumTables.clear();
+    _sumSquaredTables.clear();
+}
+
+std::vector<double> EmbeddingStatistics::summedAreaTable(const std::vector<double>& cells) const
+{
+    // Entry (x, y) is the sum of the cells [0, x) x [0, y), the extra row and column of zeros avoid the edge cases of the lookups
+    const int stride = _resolution + 1;
+    std::vector<double> table(static_cast<std::size_t>(stride) * stride, 0.0);
+
+    for (int y = 0; y < _resolution; y++) {
+        double rowSum = 0.0;
+        for (int x = 0; x < _resolution; x++) {
+            rowSum += cells[static_cast<std::size_t>(y) * _resolution + x];
+            table[static_cast<std::size_t>(y + 1) * stride + x + 1] = table[static_cast<std::size_t>(y) * stride + x + 1] + rowSum;
+        }
+    }
+
+    return table;
+}
+
+double EmbeddingStatistics::tableSum(const std::vector<double>& table, int x0, int y0, int x1, int y1) const
+{
+    const std::size_t stride = static_cast<std::size_t>(_resolution) + 1;
+    return table[y1 * stride + x1] - table[y0 * stride + x1] - table[y1 * stride + x0] + table[y0 * stride + x0];
+}
+
+void EmbeddingStatistics::addCells(int x0, int y0, int x1, int y1, Accumulator& accumulator) const
+{
+    accumulator.count += tableSum(_countTable, x0, y0, x1, y1);
+
+    for (std::size_t channel = 0; channel < _sumTables.size(); channel++) {
+        accumulator.sums[channel] += tableSum(_sumTables[channel], x0, y0, x1, y1);
+        accumulator.sumsSquared[channel] += tableSum(_sumSquaredTables[channel], x0, y0, x1, y1);
+    }
+}
+
+void EmbeddingStatistics::cellRange(const QRectF& unitRect, int& x0, int& y0, int& x1, int& y1) const
+{
+    // The unit rectangle has its y axis pointing down, the rows of the tables count from the bottom
+    x0 = std::clamp(static_cast<int>(std::floor(unitRect.left() * _resolution)), 0, _resolution);
+    x1 = std::clamp(static_cast<int>(std::ceil(unitRect.right() * _resolution)), 0, _resolution);
+    y0 = std::clamp(static_cast<int>(std::floor((1.0 - unitRect.bottom()) * _resolution)), 0, _resolution);
+    y1 = std::clamp(static_cast<int>(std::ceil((1.0 - unitRect.top()) * _resolution)), 0, _resolution);
+}
+
+ShapeStatistics EmbeddingStatistics::finish(const Accumulator& accumulator) const
+{
+    ShapeStatistics statistics;
+    statistics.valid = true;
+    statistics.count = static_cast<std::uint64_t>(std::llround(accumulator.count));
+
+    if (accumulator.count <= 0.0)
+        return statistics;
+
+    statistics.mean.resize(accumulator.sums.size());
+    statistics.variance.resize(accumulator.sums.size());
+
+    for (std::size_t channel = 0; channel < accumulator.sums.size(); channel++) {
+        const double mean = accumulator.sums[channel] / accumulator.count;
+        statistics.mean[channel] = static_cast<float>(mean);
+        statistics.variance[channel] = static_cast<float>(std::max(0.0, accumulator.sumsSquared[channel] / accumulator.count - mean * mean));
+    }
+
+    return statistics;
+}
+
+ShapeStatistics EmbeddingStatistics::rectStatistics(const QRectF& unitRect) const
+{
+    if (isEmpty())
+        return {};
+
+    Accumulator accumulator;
+    accumulator.sums.assign(_sumTables.size(), 0.0);
+    accumulator.sumsSquared.assign(_sumTables.size(), 0.0);
+
+    int x0, y0, x1, y1;
+    cellRange(unitRect, x0, y0, x1, y1);
+    if (x1 > x0 && y1 > y0)
+        addCells(x0, y0, x1, y1, accumulator);
+
+    return finish(accumulator);
+}
+
+ShapeStatistics EmbeddingStatistics::shapeStatistics(const InteractiveShape& shape) const
+{
+    if (isEmpty())
+        return {};
+
+    Accumulator accumulator;
+    accumulator.sums.assign(_sumTables.size(), 0.0);
+    accumulator.sumsSquared.assign(_sumTables.size(), 0.0);
+
+    const QRectF unitRect = shape.getUnitRect();
+
+    int x0, y0, x1, y1;
+    cellRange(unitRect, x0, y0, x1, y1);
+    if (x1 <= x0 || y1 <= y0)
+        return finish(accumulator);
+
+    // The outline is rasterized once at the resolution of the grid (one pixel per cell, filled when its center is inside),
+    // instead of testing the center of every cell against the outline. Pixel row 0 is the top row of cells, y1 - 1.
+    const int width = x1 - x0;
+    const int height = y1 - y0;
+    const QRectF shapeRect(unitRect.left() * _resolution - x0, unitRect.top() * _resolution - (_resolution - y1),
+                           unitRect.width() * _resolution, unitRect.height() * _resolution);
+
+    QPainterPath outline = shape.getOutline(shapeRect);
+    if (outline.isEmpty())
+        outline.addRect(shapeRect);
+
+    QImage cells(width, height, QImage::Format_Grayscale8);
+    cells.fill(0);
+
+    {
+        QPainter painter(&cells);
+        painter.setRenderHint(QPainter::Antialiasing, false);
+        painter.fillPath(outline, Qt::white);
+    }
+
+    // Every row of cells is split into runs of filled cells, each run is one table query
+    for (int row = 0; row < height; row++) {
+        const uchar* line = cells.constScanLine(row);
+        const int y = y1 - 1 - row;
+        int runStart = -1;
+
+        for (int x = 0; x <= width; x++) {
+            const bool inside = x < width && line[x] != 0;
+
+            if (inside && runStart < 0) {
+                runStart = x;
+            }
+            else if (!inside && runStart >= 0) {
+                addCells(x0 + runStart, y, x0 + x, y + 1, accumulator);
+                runStart = -1;
+            }
+        }
+    }
+
+    return finish(accumulator);
+}
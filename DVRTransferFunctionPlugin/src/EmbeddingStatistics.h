@@ -0,0 +1,81 @@
+#pragma once
+
+#include <graphics/Vector2f.h>
+
+#include <QRectF>
+#include <QStringList>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "InteractiveShape.h"
+
+/**
+ * Summed-area tables of the voxels over a grid on the embedding, for the statistics of the transfer function shapes.
+ *
+ * Every cell of the grid holds the number of voxels whose embedding position falls in it, and per channel the sum and the
+ * sum of squares of their feature values. The tables store the prefix sums of those, so the statistics of any rectangle
+ * of cells take four lookups per table, independent of the number of voxels. A shape is rasterized at the resolution of
+ * the grid and split into runs of filled cells, so it costs its area in cells plus a rectangle query per run.
+ *
+ * The statistics have the precision of the grid: a cell counts as a whole when its center is inside the shape.
+ */
+class EmbeddingStatistics
+{
+public:
+    /**
+     * Builds the tables, once per dataset
+     * @param positions Embedding position of every voxel
+     * @param dataBounds Bounds of the positions (left, bottom, width, height), the same rectangle the shapes are relative to
+     * @param channelNames Name of every channel of the feature vectors
+     * @param loadChannel Fills the value of a channel for every voxel (in the order of the positions), returns false on failure
+     * @param resolution Number of cells along each axis
+     * @param cancelled Optional flag that stops the build between two channels, the tables are then left empty
+     */
+    void build(const std::vector<mv::Vector2f>& positions, const QRectF& dataBounds, const QStringList& channelNames,
+               const std::function<bool(int channel, std::vector<float>& values)>& loadChannel, int resolution = 256, const std::atomic<bool>* cancelled = nullptr);
+
+    void clear();
+
+    bool isEmpty() const { return _resolution == 0; }
+
+    const QStringList& getChannelNames() const { return _channelNames; }
+
+    /**
+     * Statistics of a rectangle relative to the points window
+     * @param unitRect Rectangle with (0, 0) the top left and (1, 1) the bottom right of the data bounds
+     */
+    ShapeStatistics rectStatistics(const QRectF& unitRect) const;
+
+    /** Statistics of the voxels inside the outline of a shape */
+    ShapeStatistics shapeStatistics(const InteractiveShape& shape) const;
+
+private:
+    struct Accumulator {
+        double count = 0.0;
+        std::vector<double> sums;
+        std::vector<double> sumsSquared;
+    };
+
+    /** Adds the cells [x0, x1) x [y0, y1) (row 0 is the bottom of the data) to the accumulator */
+    void addCells(int x0, int y0, int x1, int y1, Accumulator& accumulator) const;
+
+    /** Sum of the cells [x0, x1) x [y0, y1) of a summed-area table */
+    double tableSum(const std::vector<double>& table, int x0, int y0, int x1, int y1) const;
+
+    /** Turns a grid of cell values into its summed-area table of (resolution + 1)^2 entries */
+    std::vector<double> summedAreaTable(const std::vector<double>& cells) const;
+
+    ShapeStatistics finish(const Accumulator& accumulator) const;
+
+    /** Cell range [first, last) covered by a unit rectangle, with the rows counted from the bottom */
+    void cellRange(const QRectF& unitRect, int& x0, int& y0, int& x1, int& y1) const;
+
+private:
+    int                                 _resolution = 0;
+    QStringList                         _channelNames;
+    std::vector<double>                 _countTable;
+    std::vector<std::vector<double>>    _sumTables;             // One summed-area table per channel
+    std::vector<std::vector<double>>    _sumSquaredTables;      // One summed-area table of the squared values per channel
+};
@@ -59,6 +59,7 @@ void GradientPickerAction::initialize(TransferFunctionPlugin* transferFunctionPl
             return;
         shape->updateGradient(gradientData);
         //setGradientAndImage(gradientData, shape->getGradientImage()); // This is kind of a scuffed line as this whole class is mostly meant to sent information and only recieve it when a new wshape is selected
+        widget.invalidateTextures(false);
         widget.update();
         });
 }
@@ -1,9 +1,81 @@
 #include "InteractiveShape.h"
 #include <QDebug>
 
+#include <cmath>
+
+namespace {
+
+// Douglas-Peucker: keeps the points of points[first, last] that deviate more than tolerance from the line between the kept points
+void simplifyPolyline(const QPolygonF& points, int first, int last, qreal tolerance, std::vector<bool>& keep)
+{
+    const QPointF start = points[first];
+    const QPointF direction = points[last] - start;
+    const qreal length = std::hypot(direction.x(), direction.y());
+
+    qreal maxDistance = 0.0;
+    int farthest = -1;
+    for (int i = first + 1; i < last; i++) {
+        const QPointF offset = points[i] - start;
+        const qreal distance = length > 0.0 ? std::abs(direction.x() * offset.y() - direction.y() * offset.x()) / length : std::hypot(offset.x(), offset.y());
+        if (distance > maxDistance) {
+            maxDistance = distance;
+            farthest = i;
+        }
+    }
+
+    if (farthest < 0 || maxDistance <= tolerance)
+        return;
+
+    keep[farthest] = true;
+    simplifyPolyline(points, first, farthest, tolerance, keep);
+    simplifyPolyline(points, farthest, last, tolerance, keep);
+}
+
+// Replaces the pixel staircase of an outline made from a mask by straight edges that stay within tolerance (in pixels) of it
+QPainterPath simplifyOutline(const QPainterPath& path, qreal tolerance)
+{
+    QPainterPath simplified;
+    simplified.setFillRule(path.fillRule());
+
+    for (const QPolygonF& polygon : path.toSubpathPolygons()) {
+        if (polygon.size() < 4) {
+            simplified.addPolygon(polygon);
+            simplified.closeSubpath();
+            continue;
+        }
+
+        std::vector<bool> keep(polygon.size(), false);
+        keep.front() = true;
+        keep.back() = true;
+        simplifyPolyline(polygon, 0, static_cast<int>(polygon.size()) - 1, tolerance, keep);
+
+        QPolygonF kept;
+        for (int i = 0; i < polygon.size(); i++) {
+            if (keep[i])
+                kept << polygon[i];
+        }
+
+        // Tiny islands can collapse to a line, those keep their pixels
+        simplified.addPolygon(kept.size() >= 4 ? kept : polygon);
+        simplified.closeSubpath();
+    }
+
+    return simplified;
+}
+
+}
+
 InteractiveShape::InteractiveShape(const QPixmap& pixmap, const QRectF& rect, const QRect& bounds, QColor pixmapColor, float globalAlphaValue, qreal threshold)
 	: _pixmap(pixmap), _rect(rect), _bounds(bounds), _isSelected(false), _pixmapColor(pixmapColor), _globalAlphaValue(globalAlphaValue), _threshold(threshold)  {
     _mask = _pixmap.createMaskFromColor(Qt::transparent);
+    _maskRegion = QRegion(_mask);
+
+    // The region consists of one rectangle per run of pixels, simplified merges them into the outline of the area
+    // and the staircase along its slanted edges is straightened within a pixel of the mask
+    QPainterPath maskPath;
+    maskPath.addRegion(_maskRegion);
+    if (!_pixmap.isNull())
+        _outline = QTransform::fromScale(1.0 / _pixmap.width(), 1.0 / _pixmap.height()).map(simplifyOutline(maskPath.simplified(), 0.75));
 
     _gradient1D = QImage(":textures/gaussian1D_texture", ".png");
     _gradient2D = QImage(":textures/gaussian_texture", ".png");
@@ -11,8 +83,6 @@ InteractiveShape::InteractiveShape(const QPixmap& pixmap, const QRectF& rect, co
 	//_gradient2D.scaled(_pixmap.size());
 
 	_gradientData = { false, 0, 0.0f, 0.0f, 1.0f, 1.0f, 0 };
-
-	setGlobalAlphaValue(globalAlphaValue); // This will create the globalAlphaPixmap
 }
 
 void InteractiveShape::draw(QPainter& painter, bool drawBorder, bool useGlobalAlpha, bool normalizeWindow /*true*/, QColor borderColor /* Black */) const {
@@ -34,12 +104,20 @@ void InteractiveShape::draw(QPainter& painter, bool drawBorder, bool useGlobalAl
     }
 
     painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    // Only the gradient needs the pixmap, the solid colors are filled with the outline
+    bool useGradient = _gradientData.gradient && !_usedGradient.isNull();
 	if (useGlobalAlpha) {
-		painter.drawPixmap(adjustedRect.toRect(), _globalAlphaColormap);
+        QColor globalColor = _pixmapColor;
+        globalColor.setAlpha(_globalAlphaValue);
+		painter.fillPath(getOutline(adjustedRect), globalColor);
 	}
-    else {
+    else if (useGradient) {
         painter.drawPixmap(adjustedRect.toRect(), _pixmap);
     }
+    else {
+        painter.fillPath(getOutline(adjustedRect), _pixmapColor);
+    }
 }
 
 void InteractiveShape::drawID(QPainter& painter, bool normalizeWindow, int id) const {
@@ -52,20 +130,27 @@ void InteractiveShape::drawID(QPainter& painter, bool normalizeWindow, int id) c
     }
 
     painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    
-    QPixmap newPixmap(_pixmap.size());
-    newPixmap.fill(Qt::transparent);
-
-    QPainter tempPainter(&newPixmap);
-    tempPainter.setClipRegion(QRegion(_mask));
-	tempPainter.fillRect(newPixmap.rect(), QColor(id, id, id));
-    tempPainter.end();
 
-    painter.drawPixmap(adjustedRect.toRect(), newPixmap);
+    // The painters of the ID maps do not antialias, so the edges keep the exact ID
+    painter.fillPath(getOutline(adjustedRect), QColor(id, id, id));
 }
 
 bool InteractiveShape::contains(const QPointF& point) const {
-    return getRelativeRect().contains(point);
+    QRectF relativeRect = getRelativeRect();
+    if (relativeRect.isEmpty() || !relativeRect.contains(point))
+        return false;
+
+    // Clicks inside the rectangle but outside of the selected area do not hit the shape
+    QPointF unitPoint((point.x() - relativeRect.left()) / relativeRect.width(), (point.y() - relativeRect.top()) / relativeRect.height());
+    return _outline.isEmpty() || _outline.contains(unitPoint);
+}
+
+bool InteractiveShape::containsUnitPosition(const QPointF& position) const {
+    if (_rect.isEmpty() || !_rect.contains(position))
+        return false;
+
+    QPointF unitPoint((position.x() - _rect.left()) / _rect.width(), (position.y() - _rect.top()) / _rect.height());
+    return _outline.isEmpty() || _outline.contains(unitPoint);
 }
 
 void InteractiveShape::moveBy(const QPointF& delta) {
@@ -139,23 +224,11 @@ bool InteractiveShape::getSelected() const {
 
 void InteractiveShape::setColor(const QColor& color) {
 
-    _pixmapColor = color;
-
-    QPixmap newPixmap(_pixmap.size());
-    newPixmap.fill(Qt::transparent);
-
-    QPainter painter(&newPixmap);
-    painter.setClipRegion(QRegion(_mask));
-    painter.fillRect(newPixmap.rect(), color);
-
-    _colormap = newPixmap;
-
-	QColor globalColor = _pixmapColor;
-    globalColor.setAlpha(_globalAlphaValue);
-    painter.fillRect(newPixmap.rect(), globalColor);
-    painter.end();
+    if (color == _pixmapColor && !_colormap.isNull())
+        return;
 
-	_globalAlphaColormap = newPixmap;
+    _pixmapColor = color;
+    _colormap = fillMask(color);
 
     updatePixmap();
 }
@@ -217,22 +290,8 @@ gradientData InteractiveShape::getGradientData() const
 
 void InteractiveShape::setGlobalAlphaValue(int globalAlphaValue)
 {
+    // The global alpha color is filled through the outline when the shape is drawn, there is no pixmap to update
 	_globalAlphaValue = globalAlphaValue;
-
-	//Update _globalAlphaColormap
-	QColor globalColor = _pixmapColor;
-	globalColor.setAlpha(_globalAlphaValue);
-
-	QPixmap newPixmap(_pixmap.size());
-	newPixmap.fill(Qt::transparent);
-
-	QPainter painter(&newPixmap);
-	painter.setClipRegion(QRegion(_mask));
-	painter.fillRect(newPixmap.rect(), globalColor);
-	painter.end();
-
-	_globalAlphaColormap = newPixmap;
-	updatePixmap();
 }
 
 void InteractiveShape::updatePixmap()
@@ -242,19 +301,32 @@ void InteractiveShape::updatePixmap()
 
     if (_usedGradient.isNull() || !_gradientData.gradient) {
         _pixmap = _colormap;
-		_globalAlphaPixmap = _globalAlphaColormap;
     }
     else {
         QImage pixmapImage = _colormap.toImage();
         pixmapImage.setAlphaChannel(_usedGradient);
         _pixmap = QPixmap::fromImage(pixmapImage);
-
-		QImage globalAlphaImage = _globalAlphaColormap.toImage();
-		globalAlphaImage.setAlphaChannel(_usedGradient);
-		_globalAlphaPixmap = QPixmap::fromImage(globalAlphaImage);
     }
 }
 
+QPixmap InteractiveShape::fillMask(const QColor& color) const
+{
+    QPixmap newPixmap(_pixmap.size());
+    newPixmap.fill(Qt::transparent);
+
+    QPainter painter(&newPixmap);
+    painter.setClipRegion(_maskRegion);
+    painter.fillRect(newPixmap.rect(), color);
+    painter.end();
+
+    return newPixmap;
+}
+
+QPainterPath InteractiveShape::getOutline(const QRectF& targetRect) const
+{
+    return QTransform(targetRect.width(), 0.0, 0.0, targetRect.height(), targetRect.left(), targetRect.top()).map(_outline);
+}
+
 QRectF InteractiveShape::getRelativeRect() const {
     return QRectF(
         _bounds.left() + _rect.left() * _bounds.width(),
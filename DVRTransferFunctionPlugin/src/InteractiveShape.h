@@ -4,6 +4,11 @@
 #include <QRectF>
 #include <QPixmap>
 #include <QBitmap>
+#include <QRegion>
+#include <QPainterPath>
+
+#include <cstdint>
+#include <vector>
 
 enum class SelectedSide {
     None,
@@ -23,6 +28,14 @@ struct gradientData {
 	int rotation;
 };
 
+// Statistics of the voxels whose embedding position lies inside a shape, see EmbeddingStatistics
+struct ShapeStatistics {
+    bool valid = false;
+    std::uint64_t count = 0;            // Number of voxels
+    std::vector<float> mean;            // Mean per channel of the feature vectors
+    std::vector<float> variance;        // Variance per channel of the feature vectors
+};
+
 class InteractiveShape {
 public:
     InteractiveShape(const QPixmap& pixmap, const QRectF& rect, const QRect& bounds, QColor pixmapColor, float globalAlphaValue, qreal threshold = 10.0);
@@ -30,6 +43,7 @@ public:
     void draw(QPainter& painter, bool drawBorder, bool useGlobalAlpha, bool normalizeWindow = true, QColor borderColor = Qt::black) const;
 	void drawID(QPainter& painter, bool normalizeWindow, int id) const;
     bool contains(const QPointF& point) const;
+    bool containsUnitPosition(const QPointF& position) const;   // Position relative to the points window, (0, 0) top left and (1, 1) bottom right
     void moveBy(const QPointF& delta);
     void resizeBy(const QPointF& delta, SelectedSide& side);
 
@@ -50,19 +64,29 @@ public:
 	gradientData getGradientData() const;
 
 	void setGlobalAlphaValue(int globalAlphaValue);
+
+    void setStatistics(const ShapeStatistics& statistics) { _statistics = statistics; }
+    const ShapeStatistics& getStatistics() const { return _statistics; }
     QRectF getRelativeRect() const;
+    QRectF getUnitRect() const { return _rect; }                 // Rectangle relative to the points window
+
+    /**
+     * Outline of the selected area of the shape, independent of the resolution the shape was selected at
+     * @param targetRect Rectangle the shape is mapped into (e.g. its rectangle in a texture of any size)
+     * @return The outline in the coordinates of the target rectangle
+     */
+    QPainterPath getOutline(const QRectF& targetRect) const;
 
 private:
 
     QRectF getAbsoluteRect() const;
 
 	void updatePixmap();
+    QPixmap fillMask(const QColor& color) const;
 
 private:
     QPixmap _pixmap;
-    QPixmap _globalAlphaPixmap;
     QPixmap _colormap;
-    QPixmap _globalAlphaColormap;
 
     QRectF _rect;
     QRect _bounds;
@@ -70,6 +94,13 @@ private:
     qreal _threshold;
     QColor _pixmapColor;
     QBitmap _mask;
+    QRegion _maskRegion;            // Clip region of _mask, converting the bitmap is too slow to do for every fill
+
+    // The selected area as a vector outline in the unit square of the shape, made once from the mask when the shape is created.
+    // Solid shapes and the material IDs are filled through it, so they are rasterized at the resolution of the target
+    // instead of being resampled from the pixmap of the selection, and it is used for the hit tests. The pixel staircase
+    // of the mask is simplified away (see simplifyOutline), so a shape has tens of vertices instead of thousands.
+    QPainterPath _outline;
 
 	int _globalAlphaValue = 100;
 
@@ -78,4 +109,6 @@ private:
     QImage _usedGradient;
 
 	gradientData _gradientData;
+
+    ShapeStatistics _statistics;
 };
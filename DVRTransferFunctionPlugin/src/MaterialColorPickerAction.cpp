@@ -54,6 +54,7 @@ void MaterialColorPickerAction::initialize(TransferFunctionPlugin* transferFunct
         if (shape == nullptr)
             return;
         shape->setColor(color);
+        widget.invalidateTextures(false);
         widget.update();
         });
 }
@@ -68,6 +68,8 @@ void MaterialTransitionsAction::initialize(TransferFunctionPlugin* transferFunct
     connect(this, &MaterialTransitionsAction::transitionChanged, &widget, [this, &widget](const std::vector<std::vector<QColor>>& transitions) {
 		widget.updateMaterialTransitionTexture(transitions);
         });
+
+    connect(this, &MaterialTransitionsAction::cellChanged, &widget, &TransferFunctionWidget::updateMaterialTransitionCell);
 }
 
 void MaterialTransitionsAction::setTransitions(const std::vector<std::vector<QColor>>& transitions)
@@ -98,8 +100,17 @@ void MaterialTransitionsAction::setGlobalAlphaValue(int globalAlphaValue)
 
 void MaterialTransitionsAction::setColorOfCell(int row, int column, const QColor& color)
 {
+    if (row < 0 || column < 0 || row >= static_cast<int>(_materialTransitionTable.size()) || column >= static_cast<int>(_materialTransitionTable[row].size()))
+        return;
+
+    // Also ends the ping-pong between a linked public action and this one
+    if (_materialTransitionTable[row][column] == color)
+        return;
+
 	_materialTransitionTable[row][column] = color;
-	emit transitionChanged(_materialTransitionTable);
+
+    // Only the cell is sent on, so the table widget and the texture do not have to be rebuilt for every color picker step
+	emit cellChanged(row, column, color);
 }
 
 void MaterialTransitionsAction::connectToPublicAction(WidgetAction* publicAction, bool recursive)
@@ -113,6 +124,8 @@ void MaterialTransitionsAction::connectToPublicAction(WidgetAction* publicAction
 
     connect(this, &MaterialTransitionsAction::transitionChanged, publicTransitionsAction, &MaterialTransitionsAction::setTransitions);
     connect(publicTransitionsAction, &MaterialTransitionsAction::transitionChanged, this, &MaterialTransitionsAction::setTransitions);
+    connect(this, &MaterialTransitionsAction::cellChanged, publicTransitionsAction, &MaterialTransitionsAction::setColorOfCell);
+    connect(publicTransitionsAction, &MaterialTransitionsAction::cellChanged, this, &MaterialTransitionsAction::setColorOfCell);
 
     WidgetAction::connectToPublicAction(publicAction, recursive);
 }
@@ -131,6 +144,8 @@ void MaterialTransitionsAction::disconnectFromPublicAction(bool recursive)
 
     disconnect(this, &MaterialTransitionsAction::transitionChanged, publicTransitionsAction, &MaterialTransitionsAction::setTransitions);
     disconnect(publicTransitionsAction, &MaterialTransitionsAction::transitionChanged, this, &MaterialTransitionsAction::setTransitions);
+    disconnect(this, &MaterialTransitionsAction::cellChanged, publicTransitionsAction, &MaterialTransitionsAction::setColorOfCell);
+    disconnect(publicTransitionsAction, &MaterialTransitionsAction::cellChanged, this, &MaterialTransitionsAction::setColorOfCell);
 
     WidgetAction::disconnectFromPublicAction(recursive);
 }
@@ -157,6 +172,10 @@ MaterialTransitionsAction::Widget::Widget(QWidget* parent, MaterialTransitionsAc
         updateTable(transitions);
         });
 
+    connect(materialTransitionsAction, &MaterialTransitionsAction::cellChanged, this, [this](int row, int column, const QColor& color) {
+        updateCell(row, column, color);
+        });
+
 	connect(materialTransitionsAction, &MaterialTransitionsAction::headersChanged, this, [this, materialTransitionsAction](std::vector<InteractiveShape> interactiveShapes) {
 		updateHeaderColors(interactiveShapes);
 		});
@@ -202,6 +221,19 @@ void MaterialTransitionsAction::Widget::updateTable(const std::vector<std::vecto
     }
 }
 
+void MaterialTransitionsAction::Widget::updateCell(int row, int column, const QColor& color)
+{
+    QTableWidgetItem* item = _tableWidget.item(row, column);
+    if (item == nullptr)
+        return;
+
+    QColor displayColor = color;
+    if (_useGlobalAlpha) {
+        displayColor.setAlpha(_globalAlphaValue);
+    }
+    item->setBackground(displayColor);
+}
+
 void MaterialTransitionsAction::Widget::updateHeaderColors(std::vector<InteractiveShape> interactiveShapes)
 {
     int size = static_cast<int>(interactiveShapes.size()) + 1;
@@ -43,6 +43,7 @@ public: // Serialization
 
 signals:
     void transitionChanged(const std::vector<std::vector<QColor>>& transitions);
+    void cellChanged(int row, int column, const QColor& color);     // A single cell changed, the rest of the table is unchanged
 	void headersChanged(std::vector<InteractiveShape> interactiveShapes);
 
     void transitionSelected(int row, int column);
@@ -74,6 +75,7 @@ protected:
         int                                 _globalAlphaValue = 100;
 
         void updateTable(const std::vector<std::vector<QColor>>& transitions);
+        void updateCell(int row, int column, const QColor& color);
         void updateHeaderColors(std::vector<InteractiveShape> interactiveShapes);
 
         friend class MaterialTransitionsAction;
@@ -11,10 +11,14 @@ PointAction::PointAction(QObject* parent, const QString& title) :
     HorizontalGroupAction(parent, title),
     _transferFunctionPlugin(nullptr),
     _sizeAction(this, "Point size", 0.0, 10.0, DEFAULT_POINT_SIZE),
-    _opacityAction(this, "Point opacity", 0.0, 1.0, DEFAULT_POINT_OPACITY)
+    _opacityAction(this, "Point opacity", 0.0, 1.0, DEFAULT_POINT_OPACITY),
+    _densityLodAction(this, "Density when zoomed out", false)
 {
 	addAction(&_sizeAction);
 	addAction(&_opacityAction);
+	addAction(&_densityLodAction);
+
+    _densityLodAction.setToolTip("Draw embeddings of a million points or more as a density when the points are smaller than the pixels (the points are drawn while a selection is shown)");
 }
 
 void PointAction::connectToPublicAction(WidgetAction* publicAction, bool recursive)
@@ -29,6 +33,7 @@ void PointAction::connectToPublicAction(WidgetAction* publicAction, bool recursi
     if (recursive) {
         actions().connectPrivateActionToPublicAction(&_sizeAction, &publicPointAction->getSizeAction(), recursive);
         actions().connectPrivateActionToPublicAction(&_opacityAction, &publicPointAction->getOpacityAction(), recursive);
+        actions().connectPrivateActionToPublicAction(&_densityLodAction, &publicPointAction->getDensityLodAction(), recursive);
     }
 
     GroupAction::connectToPublicAction(publicAction, recursive);
@@ -42,6 +47,7 @@ void PointAction::disconnectFromPublicAction(bool recursive)
     if (recursive) {
         actions().disconnectPrivateActionFromPublicAction(&_sizeAction, recursive);
         actions().disconnectPrivateActionFromPublicAction(&_opacityAction, recursive);
+        actions().disconnectPrivateActionFromPublicAction(&_densityLodAction, recursive);
     }
 
     GroupAction::disconnectFromPublicAction(recursive);
@@ -53,6 +59,7 @@ void PointAction::fromVariantMap(const QVariantMap& variantMap)
 
     _sizeAction.fromParentVariantMap(variantMap);
     _opacityAction.fromParentVariantMap(variantMap);
+    _densityLodAction.fromParentVariantMap(variantMap);
 }
 
 QVariantMap PointAction::toVariantMap() const
@@ -61,6 +68,7 @@ QVariantMap PointAction::toVariantMap() const
 
     _sizeAction.insertIntoVariantMap(variantMap);
     _opacityAction.insertIntoVariantMap(variantMap);
+    _densityLodAction.insertIntoVariantMap(variantMap);
 
     return variantMap;
 }
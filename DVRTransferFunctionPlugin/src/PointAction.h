@@ -2,6 +2,7 @@
 
 #include <actions/HorizontalGroupAction.h>
 #include "actions/DecimalAction.h"
+#include "actions/ToggleAction.h"
 
 class TransferFunctionPlugin;
 
@@ -56,11 +57,13 @@ public: // Action getters
 
     DecimalAction& getSizeAction() { return _sizeAction; }
     DecimalAction& getOpacityAction() { return _opacityAction; }
+    ToggleAction& getDensityLodAction() { return _densityLodAction; }
 
 private:
     TransferFunctionPlugin* _transferFunctionPlugin;    /** Pointer to scatterplot plugin */
     DecimalAction            _sizeAction;                /** Point size action */
     DecimalAction            _opacityAction;             /** Point opacity action */
+    ToggleAction             _densityLodAction;          /** Whether large embeddings are drawn as a density when zoomed out */
 
     static constexpr double DEFAULT_POINT_SIZE      = 2.0;     /** Default point size */
     static constexpr double DEFAULT_POINT_OPACITY   = 0.5;     /** Default point opacity */
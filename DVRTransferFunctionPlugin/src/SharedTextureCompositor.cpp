@@ -0,0 +1,161 @@
+#include "SharedTextureCompositor.h"
+
+#include <QDebug>
+#include <QOpenGLContext>
+#include <QOpenGLPaintDevice>
+#include <QPainter>
+
+bool SharedTextureCompositor::init()
+{
+    initializeOpenGLFunctions();
+
+    // Without a shared context no other view can use the textures, the widget then keeps filling the datasets on the CPU only
+    QOpenGLContext* shareContext = QOpenGLContext::globalShareContext();
+    if (!shareContext || !QOpenGLContext::areSharing(QOpenGLContext::currentContext(), shareContext)) {
+        qDebug() << "SharedTextureCompositor: the context is not shared, the transfer function textures are only provided through the datasets";
+        return false;
+    }
+
+    if (!_conversionShader.addShaderFromSourceFile(QOpenGLShader::Vertex, ":shaders/SharedTexture.vert") ||
+        !_conversionShader.addShaderFromSourceFile(QOpenGLShader::Fragment, ":shaders/SharedTexture.frag") ||
+        !_conversionShader.link()) {
+        qCritical() << "SharedTextureCompositor: failed to load the conversion shader:" << _conversionShader.log();
+        return false;
+    }
+
+    _vao.create();
+    _available = true;
+    return true;
+}
+
+void SharedTextureCompositor::destroy()
+{
+    destroyTarget(_transferFunction);
+    destroyTarget(_materialPositions);
+    _vao.destroy();
+    _conversionShader.removeAllShaders();
+    _available = false;
+}
+
+void SharedTextureCompositor::destroyTarget(Target& target)
+{
+    target.paintFramebuffer.reset();
+    if (target.framebuffer != 0)
+        glDeleteFramebuffers(1, &target.framebuffer);
+    if (target.texture != 0)
+        glDeleteTextures(1, &target.texture);
+    target = Target();
+}
+
+bool SharedTextureCompositor::resize(Target& target, int textureSize, GLenum paintFormat, GLenum textureFormat)
+{
+    if (target.size == textureSize && target.texture != 0)
+        return true;
+
+    destroyTarget(target);
+
+    // No multisampling: the material IDs must not be blended at the shape edges
+    QOpenGLFramebufferObjectFormat format;
+    format.setInternalTextureFormat(paintFormat);
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil); // The paint engine clips with the stencil buffer
+    target.paintFramebuffer = std::make_unique<QOpenGLFramebufferObject>(textureSize, textureSize, format);
+
+    glGenTextures(1, &target.texture);
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, textureFormat, textureSize, textureSize, 0, textureFormat == GL_R32F ? GL_RED : GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, QOpenGLContext::currentContext()->defaultFramebufferObject());
+
+    if (!target.paintFramebuffer->isValid() || !complete) {
+        qCritical() << "SharedTextureCompositor: could not create the framebuffers of a" << textureSize << "x" << textureSize << "texture";
+        destroyTarget(target);
+        return false;
+    }
+
+    target.size = textureSize;
+    return true;
+}
+
+GLuint SharedTextureCompositor::composite(Target& target, const QSize& boundsSize, bool materialIDs, const std::function<void(QPainter&)>& paint)
+{
+    if (boundsSize.isEmpty())
+        return 0;
+
+    // The paint framebuffer has the texture size, so the shapes are painted at the texture resolution instead of being resampled afterwards.
+    // The paint device renders upside down compared to QImage, its first row is the bottom row like in the datasets.
+    target.paintFramebuffer->bind();
+    {
+        QOpenGLPaintDevice device(target.paintFramebuffer->size());
+        QPainter painter(&device);
+        painter.setRenderHint(QPainter::Antialiasing, false);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.fillRect(QRect(QPoint(0, 0), target.paintFramebuffer->size()), Qt::transparent);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        painter.scale(double(target.size) / boundsSize.width(), double(target.size) / boundsSize.height());
+        paint(painter);
+        painter.end();
+    }
+    target.paintFramebuffer->release();
+
+    // Convert the painted shapes into the shared texture
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glViewport(0, 0, target.size, target.size);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_STENCIL_TEST);
+
+    _conversionShader.bind();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, target.paintFramebuffer->texture());
+    _conversionShader.setUniformValue("source", 0);
+    _conversionShader.setUniformValue("materialIDs", materialIDs);
+
+    _vao.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    _vao.release();
+
+    _conversionShader.release();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, QOpenGLContext::currentContext()->defaultFramebufferObject());
+
+    // The texture is read from another context right after the dataset event, so the commands have to be completed here.
+    // The textures are small, a fence per consumer would not save anything measurable.
+    glFinish();
+
+    return target.texture;
+}
+
+GLuint SharedTextureCompositor::compositeTransferFunction(const std::vector<InteractiveShape>& shapes, const QSize& boundsSize, bool useGlobalAlpha, int textureSize)
+{
+    // Half floats keep the colors of the (mostly translucent) shapes accurate through the premultiplied blending
+    if (!_available || !resize(_transferFunction, textureSize, GL_RGBA16F, GL_RGBA32F))
+        return 0;
+
+    return composite(_transferFunction, boundsSize, false, [&shapes, useGlobalAlpha](QPainter& painter) {
+        for (const auto& shape : shapes)
+            shape.draw(painter, false, useGlobalAlpha, false);
+    });
+}
+
+GLuint SharedTextureCompositor::compositeMaterialPositions(const std::vector<InteractiveShape>& shapes, const QSize& boundsSize, int textureSize)
+{
+    if (!_available || !resize(_materialPositions, textureSize, GL_RGBA8, GL_R32F))
+        return 0;
+
+    return composite(_materialPositions, boundsSize, true, [&shapes](QPainter& painter) {
+        int id = 1;
+        for (const auto& shape : shapes)
+            shape.drawID(painter, false, id++);
+    });
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QSize>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "InteractiveShape.h"
+
+/**
+ * Paints the transfer function and material ID map of the shapes directly into GL textures that other views can use.
+ *
+ * The shapes are painted with QPainter into a framebuffer of the texture size, a small shader pass then converts the
+ * premultiplied result into the float layout of the datasets (straight RGBA for the transfer function, the ID for the
+ * material positions). The textures live in the context of the transfer function widget, a view whose context is in the
+ * same share group (ManiVault shares all contexts with the global share context) can copy them on the GPU.
+ *
+ * The texture, its version and the owning context are published as dynamic properties of the Images dataset
+ * (see the property names below), the dataset changed event then only has to carry the new version.
+ */
+class SharedTextureCompositor : protected QOpenGLFunctions_3_3_Core
+{
+public:
+    // Dynamic properties of the Images datasets, VolumeRenderer of the DVR view reads them under the same names
+    static constexpr const char* TextureProperty = "sharedGLTexture";           // GLuint, 0 when there is no shared texture
+    static constexpr const char* VersionProperty = "sharedGLTextureVersion";    // Incremented for every composited texture
+    static constexpr const char* ContextProperty = "sharedGLTextureContext";    // QOpenGLContext* (as quintptr) that owns the texture
+
+    /**
+     * Creates the shader and vertex array, the context of the widget has to be current
+     * @return False when the context does not share its objects with other contexts, the textures are then of no use to other views
+     */
+    bool init();
+
+    /** Frees the textures and framebuffers, the context of the widget has to be current */
+    void destroy();
+
+    bool isAvailable() const { return _available; }
+
+    /**
+     * Paints the shapes into the transfer function texture (RGBA32F, bottom row first like the dataset)
+     * @param shapes Shapes to paint, in their drawing order
+     * @param boundsSize Size of the points window the shape rectangles are relative to
+     * @param useGlobalAlpha Whether the shapes are painted with the global alpha
+     * @param textureSize Width and height of the texture
+     * @return The texture, 0 on failure
+     */
+    GLuint compositeTransferFunction(const std::vector<InteractiveShape>& shapes, const QSize& boundsSize, bool useGlobalAlpha, int textureSize);
+
+    /**
+     * Paints the material IDs of the shapes (1 for the first shape, 0 where there is none) into the material position texture (R32F)
+     * @param shapes Shapes to paint, in their drawing order
+     * @param boundsSize Size of the points window the shape rectangles are relative to
+     * @param textureSize Width and height of the texture
+     * @return The texture, 0 on failure
+     */
+    GLuint compositeMaterialPositions(const std::vector<InteractiveShape>& shapes, const QSize& boundsSize, int textureSize);
+
+private:
+    struct Target {
+        std::unique_ptr<QOpenGLFramebufferObject> paintFramebuffer;     // QPainter paints the shapes into this one
+        GLuint framebuffer = 0;                                         // Framebuffer of the conversion pass, renders into texture
+        GLuint texture = 0;                                             // The shared texture
+        int size = 0;
+    };
+
+    /** (Re)creates the framebuffers and texture of the target when the size changed */
+    bool resize(Target& target, int textureSize, GLenum paintFormat, GLenum textureFormat);
+
+    /** Paints with the given function into the paint framebuffer and converts the result into the texture of the target */
+    GLuint composite(Target& target, const QSize& boundsSize, bool materialIDs, const std::function<void(QPainter&)>& paint);
+
+    void destroyTarget(Target& target);
+
+private:
+    bool                        _available = false;
+    QOpenGLShaderProgram        _conversionShader;
+    QOpenGLVertexArrayObject    _vao;       // Core profile draws need a bound vertex array, the triangle itself has no attributes
+    Target                      _transferFunction;
+    Target                      _materialPositions;
+};
@@ -165,6 +165,7 @@ TransferFunctionPlugin::TransferFunctionPlugin(const PluginFactory* factory) :
 
 TransferFunctionPlugin::~TransferFunctionPlugin()
 {
+    cancelStatisticsBuild();
 }
 
 void TransferFunctionPlugin::init()
@@ -222,6 +223,20 @@ void TransferFunctionPlugin::init()
 		_transferFunctionWidget->update();
 		});
 
+    connect(&_settingsAction.getPointsAction().getDensityLodAction(), &ToggleAction::toggled, this, [this](bool toggled) {
+        _transferFunctionWidget->setDensityLodEnabled(toggled);
+        });
+
+    // With the sampler enabled, selecting a shape shows the points it covers
+    connect(_transferFunctionWidget, &TransferFunctionWidget::shapeSelected, this, [this](InteractiveShape* shape) {
+        if (shape == nullptr || !getSamplerAction().getEnabledAction().isChecked())
+            return;
+
+        std::vector<std::uint32_t> localIndices;
+        getPointsInShape(*shape, localIndices);
+        updateSampleContext(localIndices);
+        });
+
     _transferFunctionWidget->installEventFilter(this);
 
     getLearningCenterAction().getViewPluginOverlayWidget()->setTargetWidget(_transferFunctionWidget);
@@ -403,6 +418,9 @@ void TransferFunctionPlugin::updateVolumeData()
     if (!_transferFunctionWidget->isInitialized())
         return;
 
+    // A statistics build of the previous data reads the positions and indices that are replaced below
+    cancelStatisticsBuild();
+
     // If no dataset has been selected, don't do anything
     if (_positionDataset.isValid()) {
 
@@ -415,15 +433,127 @@ void TransferFunctionPlugin::updateVolumeData()
         // Pass the 2D points to the scatter plot widget
         _transferFunctionWidget->setData(&_positions);
 
+        // The index mappings, the highlights and the spatial index only change with the data, not with the selection
+        _positionDataset->getGlobalIndices(_localGlobalIndices);
+
+        _globalToLocalIndices.clear();
+        if (!_positionDataset->isFull()) {
+            // A dense table of four bytes per global index, a hash map would take tens of bytes per point of the subset
+            const auto maxGlobalIndex = _localGlobalIndices.empty() ? 0u : *std::max_element(_localGlobalIndices.begin(), _localGlobalIndices.end());
+            _globalToLocalIndices.assign(_localGlobalIndices.empty() ? 0 : static_cast<std::size_t>(maxGlobalIndex) + 1, NoLocalIndex);
+            for (std::uint32_t localIndex = 0; localIndex < _localGlobalIndices.size(); localIndex++)
+                _globalToLocalIndices[_localGlobalIndices[localIndex]] = localIndex;
+        }
+
+        _highlights.assign(_positions.size(), 0);
+        _highlightedLocalIndices.clear();
+        _transferFunctionWidget->setHighlights(_highlights, 0);
+
+        _embeddingGrid.build(_positions, _transferFunctionWidget->getDataBoundsRect());
+
+        updateEmbeddingStatistics();
+
         updateSelection();
     }
     else {
         _numPoints = 0;
         _positions.clear();
+        _localGlobalIndices.clear();
+        _globalToLocalIndices.clear();
+        _highlights.clear();
+        _highlightedLocalIndices.clear();
+        _embeddingGrid.clear();
+        _statisticsGeneration++; // A finished build that is not published yet belongs to the previous data
+        _embeddingStatistics.clear();
         _transferFunctionWidget->setData(&_positions);
+        _transferFunctionWidget->setEmbeddingStatistics(nullptr);
     }
 }
 
+void TransferFunctionPlugin::updateEmbeddingStatistics()
+{
+    // The features of the voxels are in the source data of the embedding, the embedding itself when it has no other source
+    auto featureDataset = _positionDataset->getSourceDataset<Points>();
+    if (!featureDataset.isValid())
+        featureDataset = _positionDataset;
+
+    const auto dimensionNames = featureDataset->getDimensionNames();
+    const int numChannels = std::min(static_cast<std::int32_t>(featureDataset->getNumDimensions()), MAX_STATISTICS_CHANNELS);
+
+    QStringList channelNames;
+    for (int channel = 0; channel < numChannels; channel++)
+        channelNames << (channel < static_cast<int>(dimensionNames.size()) ? dimensionNames[channel] : QString("Dimension %1").arg(channel));
+
+    // A full feature dataset returns the values of all points, the positions may be a subset of them and are looked up by
+    // their global index. A subset (also the embedding itself when it is a subset) returns its values in local order.
+    const bool featuresInGlobalOrder = featureDataset->isFull();
+
+    // Until the new tables are published the shapes show no statistics, the previous tables belong to the previous data
+    _transferFunctionWidget->setEmbeddingStatistics(nullptr);
+
+    const QRectF dataBounds = _transferFunctionWidget->getDataBoundsRect();
+    const std::uint64_t generation = ++_statisticsGeneration;
+
+    // Reading up to MAX_STATISTICS_CHANNELS full channels and binning them takes seconds for large volumes, so it runs on a worker thread.
+    // The worker reads _positions and _localGlobalIndices, cancelStatisticsBuild() is called before they change.
+    _statisticsBuildCancelled = false;
+    _statisticsBuildTask = std::async(std::launch::async, [this, featureDataset, channelNames, dataBounds, featuresInGlobalOrder, generation]() {
+        auto statistics = std::make_shared<EmbeddingStatistics>();
+
+        try {
+            std::vector<float> featureValues;
+            statistics->build(_positions, dataBounds, channelNames, [this, &featureDataset, &featureValues, featuresInGlobalOrder](int channel, std::vector<float>& values) -> bool {
+                featureDataset->populateDataForDimensions(featureValues, std::vector<int>{ channel });
+
+                if (!featuresInGlobalOrder) {
+                    if (featureValues.size() != _positions.size())
+                        return false;
+
+                    values.swap(featureValues);
+                    return true;
+                }
+
+                values.resize(_localGlobalIndices.size());
+                for (std::size_t localIndex = 0; localIndex < _localGlobalIndices.size(); localIndex++) {
+                    const auto globalIndex = _localGlobalIndices[localIndex];
+                    if (globalIndex >= featureValues.size())
+                        return false;
+
+                    values[localIndex] = featureValues[globalIndex];
+                }
+
+                return true;
+                }, 256, &_statisticsBuildCancelled);
+        }
+        catch (const std::exception& e) {
+            qCritical() << "Failed to build the embedding statistics:" << e.what();
+            return;
+        }
+
+        if (_statisticsBuildCancelled)
+            return;
+
+        // The tables are handed to the GUI thread, the call is dropped when the plugin is destroyed first
+        QMetaObject::invokeMethod(this, [this, statistics, generation]() {
+            if (generation != _statisticsGeneration)
+                return;
+
+            _embeddingStatistics = std::move(*statistics);
+            _transferFunctionWidget->setEmbeddingStatistics(&_embeddingStatistics);
+            }, Qt::QueuedConnection);
+    });
+}
+
+void TransferFunctionPlugin::cancelStatisticsBuild()
+{
+    if (!_statisticsBuildTask.valid())
+        return;
+
+    _statisticsBuildCancelled = true;
+    _statisticsBuildTask.wait();
+    _statisticsBuildTask = {};
+}
+
 void TransferFunctionPlugin::updateSelection()
 {
     if (!_positionDataset.isValid())
@@ -433,61 +563,89 @@ void TransferFunctionPlugin::updateSelection()
 
     auto selection = _positionDataset->getSelection<Points>();
 
-    std::vector<bool> selected;
-    std::vector<char> highlights;
-
-    _positionDataset->selectedLocalIndices(selection->indices, selected);
+    // Map the selected (global) indices to the points of this dataset, a full dataset uses the same indices
+    std::vector<std::uint32_t> selectedLocalIndices;
+    selectedLocalIndices.reserve(selection->indices.size());
 
-    highlights.resize(_positionDataset->getNumPoints(), 0);
+    for (auto globalIndex : selection->indices) {
+        if (_globalToLocalIndices.empty()) {
+            if (globalIndex < _highlights.size())
+                selectedLocalIndices.push_back(globalIndex);
+        }
+        else if (globalIndex < _globalToLocalIndices.size() && _globalToLocalIndices[globalIndex] != NoLocalIndex) {
+            selectedLocalIndices.push_back(_globalToLocalIndices[globalIndex]);
+        }
+    }
 
-    for (std::size_t i = 0; i < selected.size(); i++)
-        highlights[i] = selected[i] ? 1 : 0;
+    // Nothing to upload when the selection of this dataset did not change (e.g. a selection of points that are not in it)
+    if (selectedLocalIndices == _highlightedLocalIndices)
+        return;
 
-    _transferFunctionWidget->setHighlights(highlights, static_cast<std::int32_t>(selection->indices.size()));
+    // Only the points that left or joined the selection are touched, instead of rebuilding the highlights of all points
+    // (the point renderer has no partial upload, so setHighlights still uploads the flags of all points)
+    for (auto localIndex : _highlightedLocalIndices)
+        _highlights[localIndex] = 0;
 
-    if (getSamplerAction().getSamplingMode() == ViewPluginSamplerAction::SamplingMode::Selection) {
-        std::vector<std::uint32_t> localGlobalIndices;
+    for (auto localIndex : selectedLocalIndices)
+        _highlights[localIndex] = 1;
 
-        _positionDataset->getGlobalIndices(localGlobalIndices);
+    _highlightedLocalIndices = std::move(selectedLocalIndices);
 
-        std::vector<std::uint32_t> sampledPoints;
+    _transferFunctionWidget->setHighlights(_highlights, static_cast<std::int32_t>(_highlightedLocalIndices.size()));
 
-        sampledPoints.reserve(_positions.size());
+    if (getSamplerAction().getSamplingMode() == ViewPluginSamplerAction::SamplingMode::Selection)
+        updateSampleContext(_highlightedLocalIndices);
+}
 
-        for (auto selectionIndex : selection->indices)
-            sampledPoints.push_back(selectionIndex);
+void TransferFunctionPlugin::updateSampleContext(const std::vector<std::uint32_t>& localIndices)
+{
+    std::int32_t numberOfPoints = 0;
 
-        std::int32_t numberOfPoints = 0;
+    QVariantList localPointIndices, globalPointIndices;
 
-        QVariantList localPointIndices, globalPointIndices;
+    localPointIndices.reserve(static_cast<std::int32_t>(localIndices.size()));
+    globalPointIndices.reserve(static_cast<std::int32_t>(localIndices.size()));
 
-        const auto numberOfSelectedPoints = selection->indices.size();
+    for (const auto& localPointIndex : localIndices) {
+        if (getSamplerAction().getRestrictNumberOfElementsAction().isChecked() && numberOfPoints >= getSamplerAction().getMaximumNumberOfElementsAction().getValue())
+            break;
 
-        localPointIndices.reserve(static_cast<std::int32_t>(numberOfSelectedPoints));
-        globalPointIndices.reserve(static_cast<std::int32_t>(numberOfSelectedPoints));
+        const auto globalPointIndex = localPointIndex < _localGlobalIndices.size() ? _localGlobalIndices[localPointIndex] : localPointIndex;
 
-        for (const auto& sampledPoint : sampledPoints) {
-            if (getSamplerAction().getRestrictNumberOfElementsAction().isChecked() && numberOfPoints >= getSamplerAction().getMaximumNumberOfElementsAction().getValue())
-                break;
+        localPointIndices << localPointIndex;
+        globalPointIndices << globalPointIndex;
 
-            const auto& localPointIndex = sampledPoint;
-            const auto& globalPointIndex = localGlobalIndices[localPointIndex];
+        numberOfPoints++;
+    }
 
-            localPointIndices << localPointIndex;
-            globalPointIndices << globalPointIndex;
+    _transferFunctionWidget->update();
 
-            numberOfPoints++;
-        }
+    getSamplerAction().setSampleContext({
+        { "PositionDatasetID", _positionDataset.getDatasetId() },
+        { "LocalPointIndices", localPointIndices },
+        { "GlobalPointIndices", globalPointIndices },
+        { "Distances", QVariantList()}
+	});
+}
 
-        _transferFunctionWidget->update();
+void TransferFunctionPlugin::getPointsInShape(const InteractiveShape& shape, std::vector<std::uint32_t>& localIndices) const
+{
+    const QRectF dataBounds = _transferFunctionWidget->getDataBoundsRect();
+    if (_embeddingGrid.isEmpty() || dataBounds.isEmpty())
+        return;
 
-        getSamplerAction().setSampleContext({
-            { "PositionDatasetID", _positionDataset.getDatasetId() },
-            { "LocalPointIndices", localPointIndices },
-            { "GlobalPointIndices", globalPointIndices },
-            { "Distances", QVariantList()}
-		});
-    }
+    // The shapes are relative to the points window, which shows the data bounds with the y axis pointing down
+    const QRectF unitRect = shape.getUnitRect();
+    const QRectF worldRect(
+        dataBounds.left() + unitRect.left() * dataBounds.width(),
+        dataBounds.top() + (1.0 - unitRect.bottom()) * dataBounds.height(),
+        unitRect.width() * dataBounds.width(),
+        unitRect.height() * dataBounds.height());
+
+    // The grid narrows the points down to the rectangle of the shape, only those are tested against its outline
+    _embeddingGrid.queryRect(worldRect, localIndices, [&shape, &dataBounds](const mv::Vector2f& point) {
+        return shape.containsUnitPosition(QPointF((point.x - dataBounds.left()) / dataBounds.width(), 1.0 - (point.y - dataBounds.top()) / dataBounds.height()));
+    });
 }
 
 void TransferFunctionPlugin::fromVariantMap(const QVariantMap& variantMap)
@@ -511,6 +669,9 @@ void TransferFunctionPlugin::fromVariantMap(const QVariantMap& variantMap)
 
 QVariantMap TransferFunctionPlugin::toVariantMap() const
 {
+    // The texture datasets are saved with the project, they may still be behind the last edits of the widget
+    _transferFunctionWidget->flushDatasets();
+
     QVariantMap variantMap = ViewPlugin::toVariantMap();
 
     _primaryToolbarAction.insertIntoVariantMap(variantMap);
@@ -7,9 +7,18 @@
 
 #include "SettingsAction.h"
 #include "MaterialSettings.h"
+#include "EmbeddingGrid.h"
+#include "EmbeddingStatistics.h"
+#include "InteractiveShape.h"
 
 #include <QTimer>
 
+#include <atomic>
+#include <future>
+#include <limits>
+#include <memory>
+#include <vector>
+
 using namespace mv::plugin;
 using namespace mv::util;
 using namespace mv::gui;
@@ -71,6 +80,24 @@ private:
     void updateVolumeData();
     void updateSelection();
 
+    /** Sets the sampler context to the given points of the position dataset */
+    void updateSampleContext(const std::vector<std::uint32_t>& localIndices);
+
+    /** Builds the voxel statistics of the shapes from the source data of the position dataset, on a worker thread */
+    void updateEmbeddingStatistics();
+
+    /** Stops a running statistics build and waits until the worker thread has finished */
+    void cancelStatisticsBuild();
+
+public:
+
+    /**
+     * Collects the points of the position dataset that lie inside a shape, using the spatial index of the embedding
+     * @param shape Shape of the transfer function widget
+     * @param localIndices Receives the indices of the points inside the outline of the shape (appended)
+     */
+    void getPointsInShape(const InteractiveShape& shape, std::vector<std::uint32_t>& localIndices) const;
+
 public: // Serialization
 
     /**
@@ -92,6 +119,16 @@ private:
     Dataset<Points>                 _positionDataset;           /** Smart pointer to points dataset for point position */
     std::vector<mv::Vector2f>       _positions;                 /** Point positions */
     unsigned int                    _numPoints;                 /** Number of point positions */
+    std::vector<std::uint32_t>      _localGlobalIndices;        /** Global index of every point of the position dataset */
+    std::vector<std::uint32_t>      _globalToLocalIndices;      /** Point of the position dataset of every global index up to the largest one (NoLocalIndex when not in it), empty for a full dataset */
+    static constexpr std::uint32_t  NoLocalIndex = std::numeric_limits<std::uint32_t>::max();
+    std::vector<char>               _highlights;                /** Highlight flag of every point, updated incrementally */
+    std::vector<std::uint32_t>      _highlightedLocalIndices;   /** Points that are highlighted now, cleared on the next selection change */
+    EmbeddingGrid                   _embeddingGrid;             /** Spatial index of the point positions */
+    EmbeddingStatistics             _embeddingStatistics;       /** Summed-area tables of the voxel features over the embedding, only replaced on the GUI thread */
+    std::future<void>               _statisticsBuildTask;       /** Builds the next tables on a worker thread, it reads _positions and _localGlobalIndices until it finished */
+    std::atomic<bool>               _statisticsBuildCancelled = false;
+    std::uint64_t                   _statisticsGeneration = 0;  /** Incremented for every build, a finished build is only published when no other one started since */
 
     SettingsAction                  _settingsAction;            /** Group action for all settings */
 	MaterialSettings				_materialSettings;          /** Material settings action */
@@ -99,6 +136,7 @@ private:
     QRectF                          _selectionBoundaries;       /** Boundaries of the selection */
 
     static const std::int32_t LAZY_UPDATE_INTERVAL = 2;
+    static const std::int32_t MAX_STATISTICS_CHANNELS = 32;    /** The statistics cover at most this many channels of the source data */
 
 };
 
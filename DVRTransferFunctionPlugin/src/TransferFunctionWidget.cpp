@@ -4,7 +4,9 @@
 
 #include <util/Exception.h>
 
+#include <algorithm>
 #include <vector>
+#include <chrono>
 
 #include <QDebug>
 #include <QGuiApplication>
@@ -12,12 +14,17 @@
 #include <QOpenGLFramebufferObject>
 #include <QPainter>
 #include <QSize>
+#include <QToolTip>
 #include <QWheelEvent>
 #include <QWindow>
 #include <QRectF>
 
 #include <math.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "TransferFunctionPlugin.h"
 
 using namespace mv;
@@ -39,6 +46,99 @@ namespace
         return bounds;
     }
 
+    // Nearest neighbour lookup table, texel i of a texture of textureSize texels reads source pixel i * sourceSize / textureSize
+    std::vector<int> resampleIndices(int textureSize, int sourceSize)
+    {
+        std::vector<int> indices(textureSize);
+        for (int i = 0; i < textureSize; i++)
+            indices[i] = i * sourceSize / textureSize;
+        return indices;
+    }
+
+    // Resamples an ARGB32 image to a square RGBA float texture (bottom row first), reading the scanlines directly.
+    // The conversion divides by 255 like QColor::redF() and friends, so the result is identical to the pixelColor() path.
+    void resampleToRGBA(const QImage& image, int textureSize, std::vector<float>& data)
+    {
+        Q_ASSERT(image.format() == QImage::Format_ARGB32);
+
+        const std::vector<int> columns = resampleIndices(textureSize, image.width());
+        const std::vector<int> rows = resampleIndices(textureSize, image.height());
+        data.resize(static_cast<size_t>(textureSize) * textureSize * 4);
+
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < textureSize; y++) {
+            const QRgb* sourceRow = reinterpret_cast<const QRgb*>(image.constScanLine(rows[y]));
+            float* target = data.data() + static_cast<size_t>(textureSize - 1 - y) * textureSize * 4;
+
+            #pragma omp simd
+            for (int x = 0; x < textureSize; x++) {
+                const QRgb pixel = sourceRow[columns[x]];
+                target[x * 4 + 0] = qRed(pixel) / 255.0f;
+                target[x * 4 + 1] = qGreen(pixel) / 255.0f;
+                target[x * 4 + 2] = qBlue(pixel) / 255.0f;
+                target[x * 4 + 3] = qAlpha(pixel) / 255.0f;
+            }
+        }
+    }
+
+    // Resamples the red channel (the material ID) of an ARGB32 image to a square single channel float texture (bottom row first)
+    void resampleToRed(const QImage& image, int textureSize, std::vector<float>& data)
+    {
+        Q_ASSERT(image.format() == QImage::Format_ARGB32);
+
+        const std::vector<int> columns = resampleIndices(textureSize, image.width());
+        const std::vector<int> rows = resampleIndices(textureSize, image.height());
+        data.resize(static_cast<size_t>(textureSize) * textureSize);
+
+        #pragma omp parallel for schedule(static)
+        for (int y = 0; y < textureSize; y++) {
+            const QRgb* sourceRow = reinterpret_cast<const QRgb*>(image.constScanLine(rows[y]));
+            float* target = data.data() + static_cast<size_t>(textureSize - 1 - y) * textureSize;
+
+            #pragma omp simd
+            for (int x = 0; x < textureSize; x++)
+                target[x] = static_cast<float>(qRed(sourceRow[columns[x]]));
+        }
+    }
+
+#ifdef TF_TEXTURE_BENCHMARK
+    // The original per texel implementation, only kept as the reference of the benchmark
+    void resampleToRGBAWithPixelColor(const QImage& image, int textureSize, std::vector<float>& data)
+    {
+        data.clear();
+        data.reserve(static_cast<size_t>(textureSize) * textureSize * 4);
+
+        for (int y = textureSize - 1; y >= 0; y--) {
+            for (int x = 0; x < textureSize; x++) {
+                QColor color = image.pixelColor(x * image.width() / textureSize, y * image.height() / textureSize);
+                data.push_back(color.redF());
+                data.push_back(color.greenF());
+                data.push_back(color.blueF());
+                data.push_back(color.alphaF());
+            }
+        }
+    }
+
+    // Times both implementations for a range of texture sizes on the given shape image and checks that they agree
+    void benchmarkTextureResampling(const QImage& image)
+    {
+        std::vector<float> reference;
+        std::vector<float> result;
+
+        for (int textureSize : { 128, 256, 512, 1024 }) {
+            auto start = std::chrono::steady_clock::now();
+            resampleToRGBAWithPixelColor(image, textureSize, reference);
+            double referenceTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            resampleToRGBA(image, textureSize, result);
+            double scanLineTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            qDebug() << "TF texture" << textureSize << "x" << textureSize << ": pixelColor" << referenceTime << "ms, scanlines" << scanLineTime << "ms"
+                     << (reference == result ? "(identical)" : "(DIFFERENT)");
+        }
+    }
+#endif
 }
 
 
@@ -54,7 +154,9 @@ TransferFunctionWidget::TransferFunctionWidget(mv::plugin::ViewPlugin* parentPlu
     _mousePositions(),
     _mouseIsPressed(false),
 	_areaSelectionBounds(0, 0, 0, 0), // Invalid Rectangle set to signal that no area is selected
-    _parentPlugin(parentPlugin)
+    _parentPlugin(parentPlugin),
+    _textureUpdateTimer(new QTimer(this)),
+    _datasetSyncTimer(new QTimer(this))
 {
     setContextMenuPolicy(Qt::CustomContextMenu);
     setAcceptDrops(true);
@@ -69,6 +171,17 @@ TransferFunctionWidget::TransferFunctionWidget(mv::plugin::ViewPlugin* parentPlu
     _pixelSelectionTool.setFixedBrushRadiusModifier(Qt::AltModifier);
     setSelectionOutlineHaloEnabled(false);
 
+    // The textures are not regenerated on every repaint (hover, navigation, ...) but only when invalidateTextures was called,
+    // at most once per interval. The timer is not restarted by further edits, so a continuous drag still updates the DVR view regularly.
+    _textureUpdateTimer->setSingleShot(true);
+    _textureUpdateTimer->setInterval(_textureUpdateInterval);
+    connect(_textureUpdateTimer, &QTimer::timeout, this, &TransferFunctionWidget::updateDirtyTextures);
+
+    // With shared textures the datasets are only filled when the edits pause, restarting the timer on every edit debounces it
+    _datasetSyncTimer->setSingleShot(true);
+    _datasetSyncTimer->setInterval(_datasetSyncDelay);
+    connect(_datasetSyncTimer, &QTimer::timeout, this, &TransferFunctionWidget::syncDatasets);
+
     connect(&_pixelSelectionTool, &PixelSelectionTool::shapeChanged, [this]() {
         if (isInitialized())
             update();
@@ -89,6 +202,7 @@ TransferFunctionWidget::TransferFunctionWidget(mv::plugin::ViewPlugin* parentPlu
 
 			_interactiveShapes.push_back(InteractiveShape(_pixelSelectionTool.getAreaPixmap().copy(adjustedBounds.toRect()), relativeRect, _boundsPointsWindow, areaColor, _globalAlphaValue));
 			emit shapeCreated(_interactiveShapes);
+            invalidateTextures();
 
             _areaSelectionBounds = QRect(0, 0, 0, 0); // Invalid Rectangle set to signal that no area is selected
             update();
@@ -159,9 +273,27 @@ bool TransferFunctionWidget::event(QEvent* event)
     if (!event)
         return QOpenGLWidget::event(event);
 
-    // The below three cases are for interactive objects
+    // The cases below are for the interactive objects
     switch (event->type())
     {
+    case QEvent::ToolTip:
+    {
+        // Hovering a shape shows the statistics of the voxels it covers
+        const auto* helpEvent = static_cast<QHelpEvent*>(event);
+        for (auto shape = _interactiveShapes.rbegin(); shape != _interactiveShapes.rend(); ++shape) {
+            if (shape->contains(helpEvent->pos())) {
+                const QString toolTip = getStatisticsToolTip(*shape);
+                if (!toolTip.isEmpty()) {
+                    QToolTip::showText(helpEvent->globalPos(), toolTip, this);
+                    return true;
+                }
+                break;
+            }
+        }
+        QToolTip::hideText();
+        event->ignore();
+        return true;
+    }
     case QEvent::MouseButtonPress:
     {
         if (const auto* mouseEvent = static_cast<QMouseEvent*>(event)) {
@@ -174,6 +306,7 @@ bool TransferFunctionWidget::event(QEvent* event)
 					_selectedObject = nullptr;
                     
 					emit shapeDeleted(_interactiveShapes);
+                    invalidateTextures();
                     update();
                     break;
                 }
@@ -215,6 +348,7 @@ bool TransferFunctionWidget::event(QEvent* event)
                     else {
                         _selectedObject->moveBy(delta);
                     }
+                    invalidateTextures();
                 }
                 else {
                     if (_pixelSelectionTool.getType() == PixelSelectionType::Rectangle) {
@@ -292,16 +426,37 @@ void TransferFunctionWidget::setData(const std::vector<Vector2f>* points)
 
     // pass un-adjusted data bounds to renderer for 2D colormapping
     _pointRenderer.setDataBounds(dataBoundsRect);
+    _dataBoundsRect = dataBoundsRect;
     
     _dataRectangleAction.setBounds(dataBounds);
     _pointRenderer.setData(*points);
 
+    // The density is only built once it is enabled, see updateDensityPyramid
+    _densityPoints = points;
+    _densityPyramidStale = true;
+    updateDensityPyramid();
+
     update();
 }
 
+void TransferFunctionWidget::updateDensityPyramid()
+{
+    if (!_densityLodEnabled || !_densityPyramidStale)
+        return;
+
+    _densityPyramidStale = false;
+
+    // Only large embeddings get a density, building it is a single parallel pass over the points
+    if (_densityPoints && _densityPoints->size() >= _densityLodMinPoints)
+        _densityPyramid.build(*_densityPoints, _dataBoundsRect, _densityPyramidResolution);
+    else
+        _densityPyramid.clear();
+}
+
 void TransferFunctionWidget::setHighlights(const std::vector<char>& highlights, const std::int32_t& numSelectedPoints)
 {
     _pointRenderer.setHighlights(highlights, numSelectedPoints);
+    _numHighlightedPoints = numSelectedPoints;
 
     update();
 }
@@ -325,9 +480,57 @@ void TransferFunctionWidget::showHighlights(bool show)
     update();
 }
 
+void TransferFunctionWidget::setDensityLodEnabled(bool enabled)
+{
+    _densityLodEnabled = enabled;
+    updateDensityPyramid();
+    update();
+}
+
+void TransferFunctionWidget::setEmbeddingStatistics(const EmbeddingStatistics* statistics)
+{
+    _embeddingStatistics = statistics;
+    updateShapeStatistics();
+    update();
+}
+
+void TransferFunctionWidget::updateShapeStatistics()
+{
+    for (auto& shape : _interactiveShapes) {
+        if (_embeddingStatistics && !_embeddingStatistics->isEmpty())
+            shape.setStatistics(_embeddingStatistics->shapeStatistics(shape));
+        else
+            shape.setStatistics(ShapeStatistics());
+    }
+}
+
+QString TransferFunctionWidget::getStatisticsToolTip(const InteractiveShape& shape) const
+{
+    const ShapeStatistics& statistics = shape.getStatistics();
+    if (!statistics.valid || !_embeddingStatistics)
+        return {};
+
+    QString toolTip = QString("<b>%1 voxels</b>").arg(statistics.count);
+    if (statistics.mean.empty())
+        return toolTip;
+
+    toolTip += "<table><tr><th align=\"left\">Channel</th><th align=\"right\">Mean</th><th align=\"right\">Variance</th></tr>";
+
+    const QStringList& channelNames = _embeddingStatistics->getChannelNames();
+    for (std::size_t channel = 0; channel < statistics.mean.size(); channel++) {
+        toolTip += QString("<tr><td>%1</td><td align=\"right\">%2</td><td align=\"right\">%3</td></tr>")
+            .arg(channel < static_cast<std::size_t>(channelNames.size()) ? channelNames[static_cast<int>(channel)] : QString::number(channel))
+            .arg(statistics.mean[channel], 0, 'g', 4)
+            .arg(statistics.variance[channel], 0, 'g', 4);
+    }
+
+    return toolTip + "</table>";
+}
+
 void TransferFunctionWidget::setGlobalAlphaToggle(bool useGlobalAlpha)
 {
 	_useGlobalAlpha = useGlobalAlpha;
+	invalidateTextures(false);
 	update();
 }
 
@@ -340,6 +543,7 @@ void TransferFunctionWidget::setGlobalAlphaValue(int globalAlphaValue)
 		shape.setGlobalAlphaValue(globalAlphaValue);
 	}
 
+	invalidateTextures(false);
 	update();
 }
 
@@ -398,10 +602,13 @@ void TransferFunctionWidget::initializeGL()
     _pointRenderer.setSelectionOutlineColor(Vector3f(1, 0, 0));
 
     createDatasets();
+    _sharedTextures.init();
 
     // OpenGL is initialized
     _isInitialized = true;
 
+    invalidateTextures();
+
     emit initialized();
 }
 
@@ -449,6 +656,11 @@ void TransferFunctionWidget::resizeGL(int w, int h)
         shape.setBounds(_boundsPointsWindow);
     }
 
+    // The shapes are relative to the points window and painted at the texture size, so resizing does not change the textures.
+    // Only the updates that were skipped while the window had no size yet are still pending.
+    if ((_tfTextureDirty || _materialPositionTextureDirty) && !_textureUpdateTimer->isActive())
+        _textureUpdateTimer->start();
+
     _pointRenderer.resize(QSize(w, h));
 }
 
@@ -459,6 +671,16 @@ void TransferFunctionWidget::paintGL()
 
 
     try {
+        // Zoomed out on a large embedding the points are smaller than the pixels, a level of the density pyramid with
+        // about one cell per pixel then shows the same distribution without drawing every point.
+        // The density has no selection highlights, so the points are drawn while there is a selection.
+        int densityLevel = -1;
+        QRectF dataScreenRect;
+        if (_densityLodEnabled && _numHighlightedPoints == 0 && !_densityPyramid.isEmpty()) {
+            dataScreenRect = getDataScreenRect();
+            densityLevel = _densityPyramid.selectLevel(std::max(dataScreenRect.width(), dataScreenRect.height()) * devicePixelRatioF());
+        }
+
         QPainter painter;
 
         // Begin mixed OpenGL/native painting
@@ -483,12 +705,19 @@ void TransferFunctionWidget::paintGL()
 
             glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
                
-            _pointRenderer.render();
+            if (densityLevel < 0)
+                _pointRenderer.render();
         }
         painter.endNativePainting();
 
         painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
 
+        if (densityLevel >= 0) {
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+            painter.drawImage(dataScreenRect, _densityPyramid.getImage(densityLevel, _densityColor));
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+        }
+
 
 		// Draw the existing shapes
         QImage materialMap = QImage(size(), QImage::Format_ARGB32);
@@ -500,6 +729,13 @@ void TransferFunctionWidget::paintGL()
             obj.draw(shapePainter, true, _useGlobalAlpha);
         }
 
+        // The number of voxels of each shape, the tooltip of the shape has the rest of its statistics
+        shapePainter.setPen(Qt::black);
+        for (const auto& obj : _interactiveShapes) {
+            if (obj.getStatistics().valid)
+                shapePainter.drawText(obj.getRelativeRect().adjusted(4, 2, -4, -2), Qt::AlignLeft | Qt::AlignBottom, QString("%1 voxels").arg(obj.getStatistics().count));
+        }
+
         shapePainter.end();
 
         paintPixelSelectionToolNative(_pixelSelectionTool, materialMap);
@@ -507,9 +743,6 @@ void TransferFunctionWidget::paintGL()
         painter.drawImage(0, 0, materialMap);
 
         painter.end();
-
-        updateTfTexture();
-		updateMaterialPositionsTexture();
     }
     catch (std::exception& e)
     {
@@ -520,6 +753,22 @@ void TransferFunctionWidget::paintGL()
     }
 }
 
+QRectF TransferFunctionWidget::getDataScreenRect()
+{
+    const QRectF dataBounds = _densityPyramid.getDataBounds();
+    const QRectF pointsWindow = QRectF(_boundsPointsWindow);
+
+    // The point renderer fits the visible world rectangle into the points window, with the y axis pointing up
+    QRectF zoomRectangle = getPointRendererNavigator().getZoomRectangleWorld();
+    if (!zoomRectangle.isValid())
+        zoomRectangle = dataBounds;
+
+    auto toScreenX = [&](double x) { return pointsWindow.left() + (x - zoomRectangle.left()) / zoomRectangle.width() * pointsWindow.width(); };
+    auto toScreenY = [&](double y) { return pointsWindow.bottom() - (y - zoomRectangle.top()) / zoomRectangle.height() * pointsWindow.height(); };
+
+    return QRectF(QPointF(toScreenX(dataBounds.left()), toScreenY(dataBounds.bottom())), QPointF(toScreenX(dataBounds.right()), toScreenY(dataBounds.top())));
+}
+
 void TransferFunctionWidget::paintPixelSelectionToolNative(PixelSelectionTool& pixelSelectionTool, QImage& image) const
 {
     if (!pixelSelectionTool.isEnabled())
@@ -535,37 +784,140 @@ void TransferFunctionWidget::paintPixelSelectionToolNative(PixelSelectionTool& p
 	pixelSelectionToolImagePainter.end();
 }
 
+void TransferFunctionWidget::invalidateTextures(bool shapeGeometryChanged)
+{
+    _tfTextureDirty = true;
+    if (shapeGeometryChanged)
+        _materialPositionTextureDirty = true;
+
+    if (!_textureUpdateTimer->isActive())
+        _textureUpdateTimer->start();
+}
+
+void TransferFunctionWidget::updateDirtyTextures()
+{
+    // Without a size there is nothing to rasterize, resizeGL invalidates the textures again
+    if (!_isInitialized || _boundsPointsWindow.isEmpty())
+        return;
+
+    // The statistics follow the shape geometry, like the material positions, and are throttled with them
+    if (_materialPositionTextureDirty && _embeddingStatistics) {
+        updateShapeStatistics();
+        update();
+    }
+
+    // Without a shared context the datasets are the only way to the DVR view, they are filled right away
+    if (!_sharedTextures.isAvailable()) {
+        if (_tfTextureDirty) {
+            _tfTextureDirty = false;
+            updateTfTexture();
+        }
+
+        if (_materialPositionTextureDirty) {
+            _materialPositionTextureDirty = false;
+            updateMaterialPositionsTexture();
+        }
+        return;
+    }
+
+    // The textures are composited on the GPU and handed over by version, the dataset data follows once the edits pause
+    makeCurrent();
+    const QSize boundsSize = _boundsPointsWindow.size();
+
+    if (_tfTextureDirty) {
+        _tfTextureDirty = false;
+        _tfDatasetStale = true;
+        publishSharedTexture(_tfTextures, _sharedTextures.compositeTransferFunction(_interactiveShapes, boundsSize, _useGlobalAlpha, _tfTextureSize));
+    }
+
+    if (_materialPositionTextureDirty) {
+        _materialPositionTextureDirty = false;
+        _materialPositionDatasetStale = true;
+        publishSharedTexture(_materialPositionTexture, _sharedTextures.compositeMaterialPositions(_interactiveShapes, boundsSize, _materialPositionTextureSize));
+    }
+
+    doneCurrent();
+    _datasetSyncTimer->start();
+}
+
+void TransferFunctionWidget::publishSharedTexture(mv::Dataset<Images>& dataset, GLuint texture)
+{
+    if (!dataset.isValid())
+        return;
+
+    // Consumers that share the context copy the texture when the version differs from the one they have,
+    // the dataset event of the later CPU fill carries the same version and is skipped by them
+    dataset->setProperty(SharedTextureCompositor::TextureProperty, QVariant::fromValue(texture));
+    dataset->setProperty(SharedTextureCompositor::VersionProperty, QVariant::fromValue(++_sharedTextureVersion));
+    dataset->setProperty(SharedTextureCompositor::ContextProperty, QVariant::fromValue(reinterpret_cast<quintptr>(texture != 0 ? context() : nullptr)));
+
+    events().notifyDatasetDataChanged(dataset);
+}
+
+void TransferFunctionWidget::flushDatasets()
+{
+    // The throttled textures are updated first (and published, when they are shared), then the datasets catch up without waiting for the pause
+    if (_isInitialized && !_boundsPointsWindow.isEmpty()) {
+        _textureUpdateTimer->stop();
+        updateDirtyTextures();
+    }
+
+    _datasetSyncTimer->stop();
+    syncDatasets();
+}
+
+void TransferFunctionWidget::syncDatasets()
+{
+    // The material transition table does not depend on the points window, its cell edits were already published as dirty texels.
+    // The full change at the end lets a consumer that missed one of those versions (and reloaded the stale dataset) catch up.
+    if (_materialTransitionDatasetStale) {
+        _materialTransitionDatasetStale = false;
+
+        if (_materialTransitionSourceDataset.isValid() && _materialTransitionTexture.isValid()) {
+            _materialTransitionSourceDataset->setData(_materialTransitionData, 4);
+            events().notifyDatasetDataChanged(_materialTransitionSourceDataset);
+            publishMaterialTransitionChange(QRect(), {});
+        }
+    }
+
+    if (!_isInitialized || _boundsPointsWindow.isEmpty())
+        return;
+
+    if (_tfDatasetStale) {
+        _tfDatasetStale = false;
+        updateTfTexture();
+    }
+
+    if (_materialPositionDatasetStale) {
+        _materialPositionDatasetStale = false;
+        updateMaterialPositionsTexture();
+    }
+}
+
 void TransferFunctionWidget::updateTfTexture()
 {
 	if (!_tfTextures.isValid())
 		return;
 
-
-    QImage materialMap = QImage(_boundsPointsWindow.width(), _boundsPointsWindow.height(), QImage::Format_ARGB32);
+    // The shapes are painted at the texture size, their outlines are rasterized there instead of being resampled from the window size
+    QImage materialMap = QImage(_tfTextureSize, _tfTextureSize, QImage::Format_ARGB32);
     materialMap.fill(Qt::transparent);
     QPainter painter(&materialMap);
     painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.scale(double(_tfTextureSize) / _boundsPointsWindow.width(), double(_tfTextureSize) / _boundsPointsWindow.height());
 
     for (const auto& obj : _interactiveShapes) {
         obj.draw(painter, false, _useGlobalAlpha, false);
     }
 
 	painter.end();
+
+#ifdef TF_TEXTURE_BENCHMARK
+    benchmarkTextureResampling(materialMap);
+#endif
+
     std::vector<float> data;
-	data.reserve(_tfTextureSize * _tfTextureSize * 4);
-
-	for (int y = _tfTextureSize - 1; y >= 0; y--) {
-        for (int x = 0; x < _tfTextureSize; x++) {
-			int normalizedX = x * materialMap.width() / _tfTextureSize;
-			int normalizedY = y * materialMap.height() / _tfTextureSize;
-
-            QColor color = materialMap.pixelColor(normalizedX, normalizedY);
-            data.push_back(color.redF());
-            data.push_back(color.greenF());
-            data.push_back(color.blueF());
-            data.push_back(color.alphaF());
-        }
-    }
+    resampleToRGBA(materialMap, _tfTextureSize, data);
 
 	_tfSourceDataset->setData(data, 4); // update the data in the dataset
     
@@ -578,11 +930,11 @@ void TransferFunctionWidget::updateMaterialPositionsTexture()
     if (!_materialPositionTexture.isValid())
         return;
 
-
-    QImage materialMap = QImage(_boundsPointsWindow.width(), _boundsPointsWindow.height(), QImage::Format_ARGB32);
+    QImage materialMap = QImage(_materialPositionTextureSize, _materialPositionTextureSize, QImage::Format_ARGB32);
     materialMap.fill(Qt::transparent);
     QPainter painter(&materialMap);
     painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.scale(double(_materialPositionTextureSize) / _boundsPointsWindow.width(), double(_materialPositionTextureSize) / _boundsPointsWindow.height());
 
     int id = 1;
     for (auto& obj : _interactiveShapes) {
@@ -592,17 +944,7 @@ void TransferFunctionWidget::updateMaterialPositionsTexture()
 	painter.end();
 
     std::vector<float> data;
-    data.reserve(_materialPositionTextureSize * _materialPositionTextureSize);
-
-    for (int y = _materialPositionTextureSize - 1; y >= 0; y--) {
-        for (int x = 0; x < _materialPositionTextureSize; x++) {
-            int normalizedX = x * materialMap.width() / _materialPositionTextureSize;
-            int normalizedY = y * materialMap.height() / _materialPositionTextureSize;
-
-            QColor color = materialMap.pixelColor(normalizedX, normalizedY);
-            data.push_back(color.red());
-        }
-    }
+    resampleToRed(materialMap, _materialPositionTextureSize, data);
 
     _materialPositionSourceDataset->setData(data, 1); // update the data in the dataset
 
@@ -616,7 +958,8 @@ void TransferFunctionWidget::updateMaterialTransitionTexture(std::vector<std::ve
 		return;
 
     // A table of all shape trasitions, the absence of a colored area is its own material
-	std::vector<float> data;
+	std::vector<float>& data = _materialTransitionData;
+    data.clear();
     data.reserve(_materialTextureSize * _materialTextureSize * 4);
 
     //for (int y = _materialTextureSize - 1; y >= 0; y--) {
@@ -641,18 +984,66 @@ void TransferFunctionWidget::updateMaterialTransitionTexture(std::vector<std::ve
     }
 
 	_materialTransitionSourceDataset->setData(data, 4); // update the data in the dataset
+    _materialTransitionDatasetStale = false;
 
 	events().notifyDatasetDataChanged(_materialTransitionSourceDataset);
+    publishMaterialTransitionChange(QRect(), {});
+}
+
+void TransferFunctionWidget::updateMaterialTransitionCell(int row, int column, const QColor& color)
+{
+    if (!_materialTransitionTexture.isValid())
+        return;
+
+    // Cells outside of the texture are dropped by the full update as well
+    if (row < 0 || column < 0 || row >= _materialTextureSize || column >= _materialTextureSize)
+        return;
+
+    // Without a full update first there is nothing to patch
+    if (_materialTransitionData.size() != static_cast<std::size_t>(_materialTextureSize * _materialTextureSize * 4))
+        return;
+
+    // Same layout as updateMaterialTransitionTexture: row y of the texture is row y of the table
+    const QVector<float> texel = { static_cast<float>(color.redF()), static_cast<float>(color.greenF()), static_cast<float>(color.blueF()), static_cast<float>(color.alphaF()) };
+    std::copy(texel.begin(), texel.end(), _materialTransitionData.begin() + (static_cast<std::size_t>(row) * _materialTextureSize + column) * 4);
+
+    // Only the changed texel is published, the dataset receives the whole table once the edits pause (see syncDatasets)
+    _materialTransitionDatasetStale = true;
+    _datasetSyncTimer->start();
+
+    publishMaterialTransitionChange(QRect(column, row, 1, 1), texel);
+}
+
+void TransferFunctionWidget::publishMaterialTransitionChange(const QRect& dirtyTexels, const QVector<float>& dirtyData)
+{
+    // A consumer that has seen the previous version only has to apply the dirty texels, any other consumer reloads the whole dataset
+    _materialTransitionTexture->setProperty(MaterialTableVersionProperty, QVariant::fromValue(++_materialTableVersion));
+    _materialTransitionTexture->setProperty(MaterialTableDirtyRectProperty, dirtyTexels);
+    _materialTransitionTexture->setProperty(MaterialTableDirtyDataProperty, QVariant::fromValue(dirtyData));
+
 	events().notifyDatasetDataChanged(_materialTransitionTexture);
 }
 
 void TransferFunctionWidget::cleanup()
 {
     qDebug() << "Deleting transferFunction widget, performing clean up...";
+
+    // The consumers fall back to the dataset data once the shared textures are gone, so that data has to hold the last edits
+    flushDatasets();
+
     _isInitialized = false;
+    _textureUpdateTimer->stop();
+    _datasetSyncTimer->stop();
 
     makeCurrent();
     _pointRenderer.destroy();
+
+    // The shared textures die with the context, the consumers fall back to the dataset data
+    if (_sharedTextures.isAvailable()) {
+        _sharedTextures.destroy();
+        publishSharedTexture(_tfTextures, 0);
+        publishSharedTexture(_materialPositionTexture, 0);
+    }
 }
 
 void TransferFunctionWidget::updatePixelRatio()
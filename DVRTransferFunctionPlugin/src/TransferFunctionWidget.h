@@ -14,8 +14,12 @@
 #include <QOpenGLFunctions_3_3_Core>
 #include <QOpenGLWidget>
 #include <QPoint>
+#include <QTimer>
 
+#include "DensityPyramid.h"
+#include "EmbeddingStatistics.h"
 #include "InteractiveShape.h"
+#include "SharedTextureCompositor.h"
 #include "ImageData/Images.h"
 
 
@@ -37,6 +41,12 @@ class TransferFunctionWidget : public QOpenGLWidget, protected QOpenGLFunctions_
     Q_OBJECT
 
 public:
+    // Dynamic properties of the material transition Images dataset that describe the change of the last dataset event,
+    // VolumeRenderer of the DVR view reads them under the same names
+    static constexpr const char* MaterialTableVersionProperty = "materialTableVersion";         // quint64, incremented for every change of the table
+    static constexpr const char* MaterialTableDirtyRectProperty = "materialTableDirtyTexels";   // QRect of the changed texels, invalid when the whole table changed
+    static constexpr const char* MaterialTableDirtyDataProperty = "materialTableDirtyData";     // QVector<float> with the RGBA values of the changed texels, row by row
+
     TransferFunctionWidget(mv::plugin::ViewPlugin* parentPlugin = nullptr);
 
     ~TransferFunctionWidget();
@@ -49,6 +59,22 @@ public:
 	// This method is public because the UI decides when to update the widget
     void updateMaterialTransitionTexture(std::vector<std::vector<QColor>> transitionsTable);
 
+    /**
+     * Changes a single transition of the material table, only that texel is sent on to the consumers
+     * @param row Row of the table (the previous material)
+     * @param column Column of the table (the current material)
+     * @param color New color of the transition
+     */
+    void updateMaterialTransitionCell(int row, int column, const QColor& color);
+
+    /**
+     * Marks the transfer function texture (and the material position texture when the shape geometry changed) as outdated.
+     * The textures are regenerated by a throttle timer, so the edits of a drag are coalesced into at most one update per interval.
+     * Must be called by everything that changes the shapes, their colors or gradients, or the global alpha.
+     * @param shapeGeometryChanged Whether shapes were added, removed, moved or resized
+     */
+    void invalidateTextures(bool shapeGeometryChanged = true);
+
 	InteractiveShape* getSelectedObject() { return _selectedObject; }
 	std::vector<InteractiveShape>& getInteractiveShapes() { return _interactiveShapes; }
 
@@ -76,10 +102,30 @@ public:
 
     void showHighlights(bool show);
 
+    /**
+     * Set whether large embeddings are drawn as a density when the points are smaller than the pixels
+     * @param enabled Whether the level of detail density may replace the points
+     */
+    void setDensityLodEnabled(bool enabled);
+
+    /**
+     * Set the voxel statistics of the embedding the shapes show, owned by the plugin
+     * @param statistics Pointer to the statistics, nullptr when there are none
+     */
+    void setEmbeddingStatistics(const EmbeddingStatistics* statistics);
+
+    /** Writes the edits that are still throttled, or only in the shared textures, to the datasets right away (e.g. before the project is saved) */
+    void flushDatasets();
+
     mv::Bounds getBounds() const {
         return _dataRectangleAction.getBounds();
     }
 
+    /** Bounds of the data as (left, bottom, width, height), the same rectangle the density and the textures span */
+    const QRectF& getDataBoundsRect() const {
+        return _dataBoundsRect;
+    }
+
 	void setGlobalAlphaToggle(bool useGlobalAlpha);
 	void setGlobalAlphaValue(int globalAlphaValue);
 
@@ -122,6 +168,21 @@ protected:
     void paintPixelSelectionToolNative(PixelSelectionTool& pixelSelectionTool, QImage& image) const;
 	void updateTfTexture();
 	void updateMaterialPositionsTexture();
+    void updateDirtyTextures();
+    void publishSharedTexture(mv::Dataset<Images>& dataset, GLuint texture);
+    void syncDatasets();
+
+    /** Rectangle of the data bounds on the screen, following the zoom of the point renderer */
+    QRectF getDataScreenRect();
+
+    /** Recomputes the voxel statistics of all shapes, only needed when the shape geometry or the statistics changed */
+    void updateShapeStatistics();
+
+    /** Builds the density of the points when it is enabled and the points changed since the last build */
+    void updateDensityPyramid();
+
+    /** Tooltip with the voxel statistics of a shape */
+    QString getStatisticsToolTip(const InteractiveShape& shape) const;
 
     void createDatasets();
     void cleanup();
@@ -156,6 +217,10 @@ signals:
 	void shapeSelected(InteractiveShape* shape);
 	void shapeCreated(std::vector<InteractiveShape> interactiveShapes);
 	void shapeDeleted(std::vector<InteractiveShape> interactiveShapes);
+
+private:
+    /** Sets the change description of the material table on the dataset and notifies the consumers */
+    void publishMaterialTransitionChange(const QRect& dirtyTexels, const QVector<float>& dirtyData);
     
 private slots:
     void updatePixelRatio();
@@ -173,6 +238,7 @@ private:
     QColor                          _backgroundColor;                   /** Background color */
     widgetSizeInfo                  _widgetSizeInfo;                    /** Info about size of the transferFunction widget */
     DecimalRectangleAction          _dataRectangleAction;               /** Rectangle action for the bounds of the loaded data */
+    QRectF                          _dataBoundsRect;                    /** Bounds of the loaded data as (left, bottom, width, height) */
     PixelSelectionTool              _pixelSelectionTool;                /** 2D pixel selection tool */
     float                           _pixelRatio;                        /** Current pixel ratio */
     QVector<QPoint>                 _mousePositions;                    /** Recorded mouse positions */
@@ -190,6 +256,33 @@ private:
 
     mv::plugin::ViewPlugin*         _parentPlugin = nullptr;
 
+    bool                            _tfTextureDirty = true;             /** The transfer function texture no longer matches the shapes */
+    bool                            _materialPositionTextureDirty = true; /** The material position texture no longer matches the shape geometry */
+    QTimer*                         _textureUpdateTimer;                /** Single shot timer that regenerates the dirty textures, limits the update rate during a drag */
+    const int                       _textureUpdateInterval = 50;        /** Minimum time between two texture updates in milliseconds */
+
+    SharedTextureCompositor         _sharedTextures;                    /** Composites the textures on the GPU for the views that share the context */
+    quint64                         _sharedTextureVersion = 0;          /** Version of the last published shared texture */
+    bool                            _tfDatasetStale = false;            /** The transfer function dataset still holds data of before the last shared texture */
+    bool                            _materialPositionDatasetStale = false; /** The material position dataset still holds data of before the last shared texture */
+    bool                            _materialTransitionDatasetStale = false; /** The material transition dataset still holds the table of before the last cell edits */
+    QTimer*                         _datasetSyncTimer;                  /** Fills the datasets on the CPU once the edits pause, for the consumers that do not share the context */
+    const int                       _datasetSyncDelay = 300;            /** Time without edits before the datasets are filled, in milliseconds */
+
+    DensityPyramid                  _densityPyramid;                    /** Histogram pyramid of the embedding, drawn instead of the points when they are denser than the pixels */
+    bool                            _densityLodEnabled = false;         /** Whether the density may replace the points */
+    bool                            _densityPyramidStale = false;       /** The points changed since the density was built, it is rebuilt once the density is enabled */
+    const std::vector<mv::Vector2f>* _densityPoints = nullptr;          /** Points of the density, owned by the plugin */
+    std::int32_t                    _numHighlightedPoints = 0;          /** Number of selected points, the density does not show the selection */
+    QColor                          _densityColor = QColor(40, 40, 40); /** Color of the density, its alpha follows the number of points */
+    const std::size_t               _densityLodMinPoints = 1000000;     /** Embeddings with fewer points are always drawn as points */
+    const int                       _densityPyramidResolution = 1024;   /** Number of cells of the finest level along each axis */
+
+    const EmbeddingStatistics*      _embeddingStatistics = nullptr;     /** Voxel statistics over the embedding, owned by the plugin */
+
+    std::vector<float>              _materialTransitionData;            /** RGBA data of the material table texture, kept to update single cells */
+    quint64                         _materialTableVersion = 0;          /** Version of the last published material table change */
+
     const int _tfTextureSize = 512;
     const int _materialTextureSize = 128;
 	const int _materialPositionTextureSize = 1024;
@@ -8,11 +8,20 @@ uniform sampler2D frontFaces;
 uniform sampler2D backFaces;
 uniform sampler3D volumeData;
 
-uniform float stepSize;
-
-uniform vec3 dimensions; // Pre-divided dimensions (1.0 / dimensions)
-uniform vec3 invDimensions; // Pre-divided dimensions (1.0 / dimensions)
-uniform vec2 invFaceTexSize; // Pre-divided faceTexSize (1.0 / faceTexSize)
+// Per-frame state shared by all programs, written once per frame by VolumeRenderer::updateFrameState (std140, binding point 0)
+layout(std140) uniform FrameState {
+    mat4 u_modelViewProjection;
+    mat4 u_model;
+    vec3 u_minClippingPlane;
+    float stepSize;             // Ray marching step size
+    vec3 u_maxClippingPlane;
+    vec3 dimensions;            // Size of the render space
+    vec3 invDimensions;         // Pre-divided dimensions (1.0 / dimensions)
+    vec3 renderCubeSize;
+    vec3 camPos;
+    vec3 lightPos;
+    vec2 invFaceTexSize;        // Pre-divided face texture size (1.0 / face texture size)
+};
 
 uniform float volumeMaxValue; 
 uniform int chosenDim;
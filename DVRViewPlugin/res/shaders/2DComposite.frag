@@ -7,12 +7,22 @@ uniform sampler3D volumeData;
 
 uniform sampler2D tfTexture;
 
-uniform vec3 dimensions;
-uniform vec3 invDimensions; // Pre-divided dimensions (1.0 / dimensions)
-uniform vec2 invFaceTexSize; // Pre-divided FaceTexSize (1.0 / FaceTexSize)
-uniform vec2 invTfTexSize;  // Pre-divided tfTexSize (1.0 / tfTexSize)
+// Per-frame state shared by all programs, written once per frame by VolumeRenderer::updateFrameState (std140, binding point 0)
+layout(std140) uniform FrameState {
+    mat4 u_modelViewProjection;
+    mat4 u_model;
+    vec3 u_minClippingPlane;
+    float stepSize;             // Ray marching step size
+    vec3 u_maxClippingPlane;
+    vec3 dimensions;            // Size of the render space
+    vec3 invDimensions;         // Pre-divided dimensions (1.0 / dimensions)
+    vec3 renderCubeSize;
+    vec3 camPos;
+    vec3 lightPos;
+    vec2 invFaceTexSize;        // Pre-divided face texture size (1.0 / face texture size)
+};
 
-uniform float stepSize;
+uniform vec2 invTfTexSize;  // Pre-divided tfTexSize (1.0 / tfTexSize)
 
 void main()
 {
@@ -5,11 +5,23 @@ layout(location = 0) out vec4 FragColor;
 uniform isampler2D rayIDTexture;    // for each pixel, a value that is either a valid ray sample ID or -1 if not used it is a 16-bit int texture
 uniform sampler2D tfTexture;        // a 2D lookup texture that maps mean positions (e.g. from a transfer function) to a color.
 
-// Uniforms to convert screen coordinates into normalized texture coordinates.
-uniform vec2 invFaceTexSize;    // 1.0 / (face texture width, face texture height)
+// Per-frame state shared by all programs, written once per frame by VolumeRenderer::updateFrameState (std140, binding point 0)
+layout(std140) uniform FrameState {
+    mat4 u_modelViewProjection;
+    mat4 u_model;
+    vec3 u_minClippingPlane;
+    float stepSize;             // Ray marching step size
+    vec3 u_maxClippingPlane;
+    vec3 dimensions;            // Size of the render space
+    vec3 invDimensions;         // Pre-divided dimensions (1.0 / dimensions)
+    vec3 renderCubeSize;
+    vec3 camPos;
+    vec3 lightPos;
+    vec2 invFaceTexSize;        // Pre-divided face texture size (1.0 / face texture size)
+};
+
 uniform vec2 invTfTexSize;      // 1.0 / (transfer function texture size)
 uniform int numRays;            // The number of rays in the batch (this is the same for all rays in the batch)
-uniform float stepSize;         // The step size used transparancy modulation
 
 
 // holds the start index for the meanPositions array for each rayID (rayIDs are decided per batch and have no relation to the pixelPos) 
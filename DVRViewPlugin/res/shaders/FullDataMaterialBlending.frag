@@ -13,12 +13,24 @@ uniform sampler2D materialTexture; // the material table, index 0 is no material
 uniform sampler2D tfTexture;
 uniform sampler3D materialVolumeData; // the volume data texture, used to sample the nearest voxel center for the materialID
 
-// Uniforms to convert screen coordinates into normalized texture coordinates.
-uniform vec2 invFaceTexSize;    // 1.0 / (face texture width, face texture height)
+// Per-frame state shared by all programs, written once per frame by VolumeRenderer::updateFrameState (std140, binding point 0)
+layout(std140) uniform FrameState {
+    mat4 u_modelViewProjection;
+    mat4 u_model;
+    vec3 u_minClippingPlane;
+    float stepSize;             // Ray marching step size
+    vec3 u_maxClippingPlane;
+    vec3 dimensions;            // Size of the render space
+    vec3 invDimensions;         // Pre-divided dimensions (1.0 / dimensions)
+    vec3 renderCubeSize;
+    vec3 camPos;
+    vec3 lightPos;
+    vec2 invFaceTexSize;        // Pre-divided face texture size (1.0 / face texture size)
+};
+
 uniform vec2 invTfTexSize;      // 1.0 / (transfer function texture size)
 uniform vec2 invMatTexSize;     // Pre-divided matTexSize (1.0 / matTexSize)
 uniform int numRays;            // The number of rays in the batch (this is the same for all rays in the batch)
-uniform float stepSize;         // The step size used for the ray marching, this is used to compensate for the alpha blending in the shader
 
 uniform bool useClutterRemover; // If true, the clutter remover is used to smoothen the visualization
 
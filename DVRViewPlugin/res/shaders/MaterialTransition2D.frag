@@ -7,19 +7,24 @@ uniform sampler2D materialTexture; // the material table, index 0 is no material
 uniform sampler2D tfTexture;
 uniform sampler3D volumeData; // contains the 2D positions of the DR
 
-uniform vec3 dimensions; 
-uniform vec3 invDimensions; // Pre-divided dimensions (1.0 / dimensions)
-uniform vec2 invFaceTexSize; // Pre-divided FaceTexSize (1.0 / FaceTexSize)
+// Per-frame state shared by all programs, written once per frame by VolumeRenderer::updateFrameState (std140, binding point 0)
+layout(std140) uniform FrameState {
+    mat4 u_modelViewProjection;
+    mat4 u_model;
+    vec3 u_minClippingPlane;
+    float stepSize;             // Ray marching step size
+    vec3 u_maxClippingPlane;
+    vec3 dimensions;            // Size of the render space
+    vec3 invDimensions;         // Pre-divided dimensions (1.0 / dimensions)
+    vec3 renderCubeSize;
+    vec3 camPos;
+    vec3 lightPos;
+    vec2 invFaceTexSize;        // Pre-divided face texture size (1.0 / face texture size)
+};
+
 uniform vec2 invTfTexSize;  // Pre-divided tfTexSize (1.0 / tfTexSize)
 uniform vec2 invMatTexSize; // Pre-divided matTexSize (1.0 / matTexSize)
 
-uniform float stepSize;
-uniform vec3 camPos; 
-uniform vec3 lightPos;
-
-uniform vec3 u_minClippingPlane;
-uniform vec3 u_maxClippingPlane;
-
 uniform bool useShading;
 uniform bool useClutterRemover;
 
@@ -1,11 +1,20 @@
 #version 330
 layout(location = 0) in vec3 pos;
 
-uniform mat4 u_modelViewProjection;
-uniform mat4 u_model; 
-uniform vec3 u_minClippingPlane;
-uniform vec3 u_maxClippingPlane;
-uniform vec3 renderCubeSize;
+// Per-frame state shared by all programs, written once per frame by VolumeRenderer::updateFrameState (std140, binding point 0)
+layout(std140) uniform FrameState {
+    mat4 u_modelViewProjection;
+    mat4 u_model;
+    vec3 u_minClippingPlane;
+    float stepSize;             // Ray marching step size
+    vec3 u_maxClippingPlane;
+    vec3 dimensions;            // Size of the render space
+    vec3 invDimensions;         // Pre-divided dimensions (1.0 / dimensions)
+    vec3 renderCubeSize;
+    vec3 camPos;
+    vec3 lightPos;
+    vec2 invFaceTexSize;        // Pre-divided face texture size (1.0 / face texture size)
+};
 
 uniform samplerBuffer renderCubePositions; // as vec3 per cube (x,y,z) where x,y,z are the cube's offset in the cube grid
 
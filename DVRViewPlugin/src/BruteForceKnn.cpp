@@ -0,0 +1,153 @@
+#include "BruteForceKnn.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+    // Squared L2 distances between one query and the points of one block (dimension-major layout)
+    inline void blockDistancesL2(const float* block, const float* query, uint32_t dimensions, float* out)
+    {
+#if defined(__AVX512F__)
+        __m512 acc = _mm512_setzero_ps();
+        for (uint32_t d = 0; d < dimensions; d++) {
+            __m512 diff = _mm512_sub_ps(_mm512_loadu_ps(block + d * 16), _mm512_set1_ps(query[d]));
+            acc = _mm512_fmadd_ps(diff, diff, acc);
+        }
+        _mm512_storeu_ps(out, acc);
+#elif defined(__AVX2__)
+        __m256 accLow = _mm256_setzero_ps();
+        __m256 accHigh = _mm256_setzero_ps();
+        for (uint32_t d = 0; d < dimensions; d++) {
+            __m256 q = _mm256_set1_ps(query[d]);
+            __m256 diffLow = _mm256_sub_ps(_mm256_loadu_ps(block + d * 16), q);
+            __m256 diffHigh = _mm256_sub_ps(_mm256_loadu_ps(block + d * 16 + 8), q);
+            accLow = _mm256_add_ps(accLow, _mm256_mul_ps(diffLow, diffLow));
+            accHigh = _mm256_add_ps(accHigh, _mm256_mul_ps(diffHigh, diffHigh));
+        }
+        _mm256_storeu_ps(out, accLow);
+        _mm256_storeu_ps(out + 8, accHigh);
+#else
+        // Written such that the compiler can vectorize the inner loop over the lanes
+        float acc[16] = {};
+        for (uint32_t d = 0; d < dimensions; d++) {
+            const float* values = block + d * 16;
+            for (int lane = 0; lane < 16; lane++) {
+                float diff = values[lane] - query[d];
+                acc[lane] += diff * diff;
+            }
+        }
+        std::copy(acc, acc + 16, out);
+#endif
+    }
+
+    // Inserts a candidate in a list of k neighbours that is sorted by ascending distance, the caller makes sure the candidate is closer than the last entry
+    inline void insertCandidate(float* topDistances, int64_t* topLabels, int k, float distance, int64_t label)
+    {
+        int position = k - 1;
+        while (position > 0 && topDistances[position - 1] > distance) {
+            topDistances[position] = topDistances[position - 1];
+            topLabels[position] = topLabels[position - 1];
+            position--;
+        }
+        topDistances[position] = distance;
+        topLabels[position] = label;
+    }
+}
+
+const char* BruteForceKnn::getInstructionSet()
+{
+#if defined(__AVX512F__)
+    return "AVX-512";
+#elif defined(__AVX2__)
+    return "AVX2";
+#else
+    return "scalar";
+#endif
+}
+
+void BruteForceKnn::build(const float* data, uint32_t numPoints, uint32_t dimensions)
+{
+    static_assert(_blockWidth == 16, "The distance kernels assume blocks of 16 points");
+
+    _numPoints = numPoints;
+    _dimensions = dimensions;
+    _numBlocks = (static_cast<size_t>(numPoints) + _blockWidth - 1) / _blockWidth;
+    _dataTileBlocks = std::max<size_t>(1, _dataTileBytes / (static_cast<size_t>(dimensions) * _blockWidth * sizeof(float)));
+
+    // NaN padding: comparisons with NaN are always false, so the padding lanes are never inserted as neighbour
+    _blocks.assign(_numBlocks * dimensions * _blockWidth, std::numeric_limits<float>::quiet_NaN());
+
+    #pragma omp parallel for
+    for (int64_t block = 0; block < static_cast<int64_t>(_numBlocks); block++) {
+        float* blockData = _blocks.data() + block * dimensions * _blockWidth;
+        for (int lane = 0; lane < _blockWidth; lane++) {
+            int64_t point = block * _blockWidth + lane;
+            if (point >= numPoints)
+                break;
+            for (uint32_t d = 0; d < dimensions; d++)
+                blockData[d * _blockWidth + lane] = data[point * dimensions + d];
+        }
+    }
+}
+
+void BruteForceKnn::clear()
+{
+    _blocks.clear();
+    _blocks.shrink_to_fit();
+    _numPoints = 0;
+    _numBlocks = 0;
+}
+
+void BruteForceKnn::search(const float* queries, int64_t numQueries, size_t queryStride, int k, float* distances, int64_t* labels) const
+{
+    const int64_t numQueryTiles = (numQueries + _queryTileSize - 1) / _queryTileSize;
+    const size_t blockSize = static_cast<size_t>(_dimensions) * _blockWidth;
+
+    #pragma omp parallel
+    {
+        std::vector<float> tileDistances(static_cast<size_t>(_queryTileSize) * k);
+        std::vector<int64_t> tileLabels(static_cast<size_t>(_queryTileSize) * k);
+        float blockDistances[_blockWidth];
+
+        #pragma omp for schedule(dynamic)
+        for (int64_t tile = 0; tile < numQueryTiles; tile++) {
+            const int64_t firstQuery = tile * _queryTileSize;
+            const int tileQueries = static_cast<int>(std::min<int64_t>(_queryTileSize, numQueries - firstQuery));
+
+            std::fill(tileDistances.begin(), tileDistances.end(), std::numeric_limits<float>::max());
+            std::fill(tileLabels.begin(), tileLabels.end(), -1);
+
+            // Every data tile is compared against all queries of the tile while it is still in cache
+            for (size_t firstBlock = 0; firstBlock < _numBlocks; firstBlock += _dataTileBlocks) {
+                const size_t lastBlock = std::min(firstBlock + _dataTileBlocks, _numBlocks);
+
+                for (int q = 0; q < tileQueries; q++) {
+                    const float* query = queries + (firstQuery + q) * queryStride;
+                    float* topDistances = tileDistances.data() + static_cast<size_t>(q) * k;
+                    int64_t* topLabels = tileLabels.data() + static_cast<size_t>(q) * k;
+
+                    for (size_t block = firstBlock; block < lastBlock; block++) {
+                        blockDistancesL2(_blocks.data() + block * blockSize, query, _dimensions, blockDistances);
+
+                        for (int lane = 0; lane < _blockWidth; lane++) {
+                            if (blockDistances[lane] < topDistances[k - 1])
+                                insertCandidate(topDistances, topLabels, k, blockDistances[lane], static_cast<int64_t>(block * _blockWidth + lane));
+                        }
+                    }
+                }
+            }
+
+            std::copy(tileDistances.begin(), tileDistances.begin() + static_cast<size_t>(tileQueries) * k, distances + firstQuery * k);
+            std::copy(tileLabels.begin(), tileLabels.begin() + static_cast<size_t>(tileQueries) * k, labels + firstQuery * k);
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Exact L2 k-nearest-neighbour search by brute force.
+ *
+ * The data points are stored in blocks of _blockWidth points in a dimension-major layout, so a single
+ * SIMD instruction (AVX-512, AVX2 or the auto-vectorized scalar fallback) handles one dimension of a whole block.
+ * Queries are processed in tiles against data tiles that fit in the L2 cache, such that every data tile is
+ * loaded from memory once per query tile instead of once per query.
+ *
+ * Used as ANN backend for volumes with few channels or moderate voxel counts, where building an HNSW index
+ * costs more than it saves and the approximation hurts quality.
+ */
+class BruteForceKnn
+{
+public:
+    /**
+     * Copies the data into the blocked layout
+     * @param data Flat data, each point is (dimensions) floats
+     * @param numPoints Number of points
+     * @param dimensions Dimensionality of a single point
+     */
+    void build(const float* data, uint32_t numPoints, uint32_t dimensions);
+
+    /** Frees the stored data */
+    void clear();
+
+    bool isBuilt() const { return _numPoints > 0; }
+    uint32_t getNumPoints() const { return _numPoints; }
+
+    /** Returns the size of the stored data in bytes */
+    size_t getMemorySize() const { return _blocks.size() * sizeof(float); }
+
+    /** Name of the instruction set the distance kernel was compiled for */
+    static const char* getInstructionSet();
+
+    /**
+     * Searches the exact k nearest neighbours, per query the results are sorted by ascending (squared L2) distance
+     * @param queries Query data, query i starts at queries + i * queryStride
+     * @param numQueries Number of queries
+     * @param queryStride Number of floats between the start of two consecutive queries
+     * @param k Number of neighbours to retrieve (should not exceed the number of points, missing neighbours get label -1)
+     * @param distances Output: numQueries * k squared distances
+     * @param labels Output: numQueries * k point indices
+     */
+    void search(const float* queries, int64_t numQueries, size_t queryStride, int k, float* distances, int64_t* labels) const;
+
+private:
+    static constexpr int        _blockWidth = 16;               // Points per block, one AVX-512 register or two AVX2 registers
+    static constexpr int        _queryTileSize = 64;            // Queries that are compared against a data tile before moving on to the next one
+    static constexpr size_t     _dataTileBytes = 256 * 1024;    // Target size of a data tile, roughly the L2 cache size of a core
+
+    std::vector<float>          _blocks;                        // numBlocks * dimensions * _blockWidth floats, padding lanes are NaN so they never become a neighbour
+    uint32_t                    _numPoints = 0;
+    uint32_t                    _dimensions = 0;
+    size_t                      _numBlocks = 0;
+    size_t                      _dataTileBlocks = 1;            // Number of blocks per data tile
+};
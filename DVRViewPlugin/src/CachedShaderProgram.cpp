@@ -0,0 +1,43 @@
+#include "CachedShaderProgram.h"
+
+#include <QDebug>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+bool CachedShaderProgram::loadShaderFromFile(const QString& vertPath, const QString& fragPath)
+{
+    // The cacheable variants only record the sources, the compilation happens in link() when there is no cached binary
+    if (!addCacheableShaderFromSourceFile(QOpenGLShader::Vertex, vertPath) || !addCacheableShaderFromSourceFile(QOpenGLShader::Fragment, fragPath) || !link()) {
+        qCritical() << "Failed to load shader program" << vertPath << fragPath << ":" << log();
+        return false;
+    }
+    bindFrameStateBlock();
+    return true;
+}
+
+void CachedShaderProgram::bindFrameStateBlock()
+{
+    // Uniform block bindings are not part of the (cached) program binary, so this is done after every link
+    QOpenGLExtraFunctions* functions = QOpenGLContext::currentContext()->extraFunctions();
+    GLuint blockIndex = functions->glGetUniformBlockIndex(programId(), FrameStateBlock);
+    if (blockIndex != GL_INVALID_INDEX)
+        functions->glUniformBlockBinding(programId(), blockIndex, FrameStateBinding);
+}
+
+bool CachedShaderProgram::ensureLoaded()
+{
+    if (!_loadAttempted) {
+        _loadAttempted = true;
+        loadShaderFromFile(_vertPath, _fragPath);
+    }
+    return isLinked();
+}
+
+bool loadCachedComputeShader(QOpenGLShaderProgram& program, const QString& path)
+{
+    if (!program.addCacheableShaderFromSourceFile(QOpenGLShader::Compute, path) || !program.link()) {
+        qCritical() << "Failed to load compute shader:" << path << program.log();
+        return false;
+    }
+    return true;
+}
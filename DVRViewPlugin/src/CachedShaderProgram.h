@@ -0,0 +1,65 @@
+#pragma once
+
+#include "graphics/Vector3f.h"
+
+#include <QOpenGLShaderProgram>
+#include <QString>
+
+/**
+ * Shader program with the interface of mv::ShaderProgram whose linked binary is cached.
+ *
+ * The shaders are added with QOpenGLShaderProgram::addCacheableShaderFromSourceFile, so link() first looks for a program
+ * binary (glGetProgramBinary) under a key of the shader sources and the driver (GL vendor, renderer and version). Qt keeps
+ * these binaries in memory, which lets additional views skip the compilation, and on disk in the cache location of the
+ * application, which lets the next start-up skip it. A driver update or an edited shader gives a new key, the program is
+ * then compiled and cached again.
+ *
+ * The program can also be set up with setSourceFiles() and linked on first use with ensureLoaded().
+ *
+ * After linking, the FrameState uniform block (the per-frame state that VolumeRenderer::updateFrameState uploads once per frame)
+ * is attached to FrameStateBinding, so the programs read it from the shared uniform buffer instead of per-program uniforms.
+ */
+class CachedShaderProgram : public QOpenGLShaderProgram
+{
+public:
+    static constexpr GLuint FrameStateBinding = 0;              // Uniform buffer binding point of the FrameState block
+    static constexpr const char* FrameStateBlock = "FrameState";
+
+    /** Compiles (or loads from the cache) and links a vertex and fragment shader, returns false and logs the error on failure */
+    bool loadShaderFromFile(const QString& vertPath, const QString& fragPath);
+
+    /** Remembers the shader files, they are compiled and linked by the first call to ensureLoaded() */
+    void setSourceFiles(const QString& vertPath, const QString& fragPath) { _vertPath = vertPath; _fragPath = fragPath; }
+
+    /** Links the program from the files given to setSourceFiles() if that was not tried yet, returns whether the program is usable */
+    bool ensureLoaded();
+
+    /** True when ensureLoaded() still has to link the program */
+    bool isPending() const { return !_loadAttempted && !_vertPath.isEmpty(); }
+
+    /** Removes the shaders, the program object itself is freed with the instance */
+    void destroy() { removeAllShaders(); }
+
+    void uniform1i(const char* name, int value) { setUniformValue(name, value); }
+    void uniform1f(const char* name, float value) { setUniformValue(name, value); }
+    void uniform2f(const char* name, float v0, float v1) { setUniformValue(name, v0, v1); }
+    void uniform3f(const char* name, float v0, float v1, float v2) { setUniformValue(name, v0, v1, v2); }
+    void uniform3fv(const char* name, int count, const mv::Vector3f* values) { setUniformValueArray(name, reinterpret_cast<const GLfloat*>(values), count, 3); }
+    void uniformMatrix4f(const char* name, const float* columnMajor) { setUniformValue(name, reinterpret_cast<const GLfloat(*)[4]>(columnMajor)); }
+
+private:
+    /** Attaches the FrameState uniform block to FrameStateBinding, programs without the block are left alone */
+    void bindFrameStateBlock();
+
+    QString _vertPath;
+    QString _fragPath;
+    bool _loadAttempted = false;    // A program that failed to compile is not tried again every frame
+};
+
+/**
+ * Compiles (or loads from the program binary cache) and links a compute shader
+ * @param program The program to add the shader to
+ * @param path Resource path of the shader
+ * @return False (after logging the error) when the shader could not be compiled or linked
+ */
+bool loadCachedComputeShader(QOpenGLShaderProgram& program, const QString& path);
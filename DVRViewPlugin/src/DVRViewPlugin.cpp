@@ -28,10 +28,16 @@ DVRViewPlugin::DVRViewPlugin(const PluginFactory* factory) :
     _currentDimensions({0, 1}),
     _dropWidget(nullptr),
     _DVRWidget(new DVRWidget()),
-    _settingsAction(this, "Settings Action")
+    _settingsAction(this, "Settings Action"),
+    _updateTimer(),
+    _pendingUpdates(0)
 {
     setObjectName("DVR OpenGL view");
 
+    _updateTimer.setSingleShot(true);
+    _updateTimer.setInterval(UPDATE_INTERVAL);
+    connect(&_updateTimer, &QTimer::timeout, this, &DVRViewPlugin::applyPendingUpdates);
+
     // Instantiate new drop widget, setting the DVR Widget as its parent
     // the parent widget hat to setAcceptDrops(true) for the drop widget to work
     _dropWidget = new DropWidget(_DVRWidget);
@@ -129,11 +135,14 @@ DVRViewPlugin::DVRViewPlugin(const PluginFactory* factory) :
     });
 
     // update data when data set changed
+    // The transfer function plugin changes its textures many times per second while a shape is edited, those changes are
+    // collected and applied together (see scheduleUpdate). The material transition table is applied right away: its changes
+    // are versioned deltas of a few texels that the renderer uploads in order, coalescing them would force full reloads.
     connect(&_volumeDataset, &Dataset<Points>::dataChanged, this, &DVRViewPlugin::updateVolumeData);
-    connect(&_tfTexture, &Dataset<Images>::dataChanged, this, &DVRViewPlugin::updateTfData);
-    connect(&_reducedPosDataset, &Dataset<Points>::dataChanged, this, &DVRViewPlugin::updateReducedPosData);
+    connect(&_tfTexture, &Dataset<Images>::dataChanged, this, [this]() { scheduleUpdate(TfUpdate); });
+    connect(&_reducedPosDataset, &Dataset<Points>::dataChanged, this, [this]() { scheduleUpdate(ReducedPosUpdate); });
     connect(&_materialTransitionTexture, &Dataset<Images>::dataChanged, this, &DVRViewPlugin::updateMaterialTransitionData);
-    connect(&_materialPositionTexture, &Dataset<Images>::dataChanged, this, &DVRViewPlugin::updateMaterialPositionsData); // New connection
+    connect(&_materialPositionTexture, &Dataset<Images>::dataChanged, this, [this]() { scheduleUpdate(MaterialPositionsUpdate); });
 
     // update settings UI when data set changed
     connect(&_volumeDataset, &Dataset<Points>::changed, this, [this]() {
@@ -294,7 +303,29 @@ void DVRViewPlugin::updateMaterialPositionsData()
         qDebug() << "DVRViewPlugin::updateMaterialPositionsData: No data to update";
     }
 }
+void DVRViewPlugin::scheduleUpdate(PendingUpdate update)
+{
+    _pendingUpdates |= update;
 
+    if (!_updateTimer.isActive())
+        _updateTimer.start();
+}
+
+void DVRViewPlugin::applyPendingUpdates()
+{
+    const std::uint32_t pendingUpdates = _pendingUpdates;
+    _pendingUpdates = 0;
+
+    // The renderer only marks its data texture as outdated in these calls, it is rebuilt once by the next frame
+    if (pendingUpdates & ReducedPosUpdate)
+        updateReducedPosData();
+
+    if (pendingUpdates & MaterialPositionsUpdate)
+        updateMaterialPositionsData();
+
+    if (pendingUpdates & TfUpdate)
+        updateTfData();
+}
 
 void DVRViewPlugin::loadData(const mv::Dataset<Points>& dataset)
 {
@@ -11,6 +11,7 @@
 
 #include "SettingsAction.h"
 
+#include <QTimer>
 #include <QWidget>
 #include <VolumeDataPlugin/Volumes.h>
 #include <ImageData/Images.h>
@@ -67,6 +68,23 @@ public:
     void updateMaterialPositionsData();
 
 private:
+    /** Changes of the linked datasets that wait for the next scheduled update */
+    enum PendingUpdate : std::uint32_t {
+        TfUpdate                = 1 << 0,
+        ReducedPosUpdate        = 1 << 1,
+        MaterialPositionsUpdate = 1 << 2
+    };
+
+    /**
+     * Records a change of a linked dataset and starts the update timer if it is not already running. The timer is not
+     * restarted by later changes, so a continuous stream of changes (e.g. dragging a shape) is applied once per interval.
+     * @param update Dataset that changed
+     */
+    void scheduleUpdate(PendingUpdate update);
+
+    /** Applies all changes recorded since the previous update, each dataset once */
+    void applyPendingUpdates();
+
     /** We create and publish some data in order to provide an self-contained DVR project */
     std::vector<std::uint32_t> generateSequence(int n);
 
@@ -88,6 +106,10 @@ protected:
     std::vector<unsigned int>   _currentDimensions;         /** Stores which dimensions of the current data are shown */
     std::vector<float>          _spatialData;               /** Spatial data */
     std::vector<float>          _valueData;                 /** Value data */
+    QTimer                      _updateTimer;               /** Single shot timer that applies the pending dataset changes */
+    std::uint32_t               _pendingUpdates;            /** Bitmask of PendingUpdate flags */
+
+    static constexpr int UPDATE_INTERVAL = 16;              /** Interval in ms of the dataset updates, about one frame at 60 Hz */
 };
 
 /**
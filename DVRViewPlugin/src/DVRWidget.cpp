@@ -6,6 +6,7 @@
 #include <QWindow>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <QTimer>
 
 DVRWidget::DVRWidget() : 
     QOpenGLWidget(),
@@ -15,7 +16,8 @@ DVRWidget::DVRWidget() :
     _camera(),
     _mousePressed(false),
     _previousMousePos(0, 0),
-    _isNavigating(false)
+    _isNavigating(false),
+    _shaderWarmUpTimer(new QTimer(this))
 {
     setAcceptDrops(true);
 
@@ -92,7 +94,10 @@ void DVRWidget::setData(const Dataset<Volumes>& dataset, std::vector<std::uint32
 
 void DVRWidget::setTfTexture(const Dataset<Images>& tfTexture)
 {
+    // The renderer uploads (or copies the shared texture of the transfer function widget) in this context
+    makeCurrent();
     _volumeRenderer.setTfTexture(tfTexture);
+    doneCurrent();
     update();
 }
 
@@ -104,13 +109,17 @@ void DVRWidget::setReducedPosData(const Dataset<Points>& reducedPosData)
 
 void DVRWidget::setMaterialTransitionTexture(const Dataset<Images>& materialTransitionTexture)
 {
+    makeCurrent();
     _volumeRenderer.setMaterialTransitionTexture(materialTransitionTexture);
+    doneCurrent();
     update();
 }
 
 void DVRWidget::setMaterialPositionTexture(const Dataset<Images>& materialPositionTexture)
 {
+    makeCurrent();
     _volumeRenderer.setMaterialPositionTexture(materialPositionTexture);
+    doneCurrent();
     update();
 }
 
@@ -139,7 +148,10 @@ void DVRWidget::setUseCustomRenderSpace(bool useCustomRenderSpace)
 
 void DVRWidget::setRenderMode(const QString& renderMode)
 {
+    // Leaving a full data mode releases the buffers of its arena, they have to be deleted in the context that created them
+    makeCurrent();
     _volumeRenderer.setRenderMode(renderMode);
+    doneCurrent();
 }
 
 void DVRWidget::setMIPDimension(int mipDimension)
@@ -180,6 +192,18 @@ void DVRWidget::initializeGL()
     _volumeRenderer.setCamera(_camera);
     _volumeRenderer.setClippingPlaneBoundery(_minClippingPlane, _maxClippingPlane);
 
+    // The shaders of the render modes are compiled on first use. When the warm-up is enabled the others are linked one at a time while the view is idle
+    _shaderWarmUpTimer->setInterval(100);
+    connect(_shaderWarmUpTimer, &QTimer::timeout, this, [this]() {
+        makeCurrent();
+        bool morePending = _volumeRenderer.warmUpNextShader();
+        doneCurrent();
+        if (!morePending)
+            _shaderWarmUpTimer->stop();
+        });
+    if (_volumeRenderer.isShaderWarmUpEnabled())
+        _shaderWarmUpTimer->start();
+
     // OpenGL is initialized
     _isInitialized = true;
 
@@ -223,6 +247,10 @@ void DVRWidget::paintGL()
     {
         update();
     }
+    else if (_volumeRenderer.isANNIndexBuilding()) // The full data modes start rendering once the index is built in the background, so we poll for it
+    {
+        QTimer::singleShot(250, this, [this]() { update(); });
+    }
 }
 
 bool DVRWidget::event(QEvent* event)
@@ -297,6 +325,7 @@ void DVRWidget::cleanup()
 {
     qDebug() << "Deleting widget, performing clean up...";
     _isInitialized = false;
+    _shaderWarmUpTimer->stop();
 
     makeCurrent();
     _volumeRenderer.destroy();
@@ -8,6 +8,7 @@
 #include <graphics/Bounds.h>
 
 #include <QOpenGLWidget>
+#include <QTimer>
 #include <QOpenGLFunctions>
 
 #include <QColor>
@@ -84,4 +85,5 @@ private:
     bool                    _mousePressed;      /* Whether the mouse is pressed */
     bool                    _isInitialized;     /* Whether OpenGL is initialized */
     bool                    _isNavigating;      /* Whether the user is navigating */
+    QTimer*                 _shaderWarmUpTimer; /* Links the shaders of the unused render modes in the background */
 };
@@ -0,0 +1,173 @@
+#include "KMeansCodebook.h"
+#include "BruteForceKnn.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <unordered_set>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+void KMeansCodebook::build(const float* data, uint32_t numPoints, uint32_t dimensions, uint32_t numCentroids, int iterations, const std::atomic<bool>* cancelled)
+{
+    clear();
+    if (numPoints == 0 || dimensions == 0 || numCentroids == 0)
+        return;
+
+    numCentroids = std::min(numCentroids, numPoints);
+
+    // The clusters are trained on a random subset, a fixed seed keeps the codebook (and thus the rendering) reproducible
+    std::mt19937 generator(42);
+    std::vector<uint32_t> trainingPoints;
+    if (numPoints <= _maxTrainingPoints) {
+        trainingPoints.resize(numPoints);
+        std::iota(trainingPoints.begin(), trainingPoints.end(), 0);
+    }
+    else {
+        // Floyd's sampling draws _maxTrainingPoints distinct points with one random number each, without a permutation of all points
+        std::unordered_set<uint32_t> chosen;
+        chosen.reserve(_maxTrainingPoints);
+        trainingPoints.reserve(_maxTrainingPoints);
+        for (uint32_t j = numPoints - _maxTrainingPoints; j < numPoints; j++) {
+            uint32_t point = std::uniform_int_distribution<uint32_t>(0, j)(generator);
+            if (!chosen.insert(point).second) {
+                point = j;
+                chosen.insert(point);
+            }
+            trainingPoints.push_back(point);
+        }
+    }
+
+    // The order of the sample is not random, it is shuffled because the first training points become the initial centroids
+    std::shuffle(trainingPoints.begin(), trainingPoints.end(), generator);
+    const uint32_t numTraining = static_cast<uint32_t>(trainingPoints.size());
+
+    std::vector<float> trainingData(static_cast<size_t>(numTraining) * dimensions);
+    #pragma omp parallel for
+    for (int64_t i = 0; i < static_cast<int64_t>(numTraining); i++)
+        std::copy_n(data + static_cast<size_t>(trainingPoints[i]) * dimensions, dimensions, trainingData.data() + i * dimensions);
+
+    // The first (random) training points are the initial centroids
+    std::vector<float> centroids(trainingData.begin(), trainingData.begin() + static_cast<size_t>(numCentroids) * dimensions);
+    std::vector<int64_t> labels(numTraining);
+    std::vector<int64_t> previousLabels(numTraining, -1);
+    std::vector<float> distances(numTraining);
+    BruteForceKnn centroidIndex;
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        if (cancelled && *cancelled)
+            return;
+
+        centroidIndex.build(centroids.data(), numCentroids, dimensions);
+        centroidIndex.search(trainingData.data(), numTraining, dimensions, 1, distances.data(), labels.data());
+
+        if (labels == previousLabels)
+            break; // Converged
+        std::swap(labels, previousLabels);
+
+        // Move every centroid to the mean of its points
+        std::vector<double> sums(static_cast<size_t>(numCentroids) * dimensions, 0.0);
+        std::vector<uint32_t> counts(numCentroids, 0);
+        for (uint32_t i = 0; i < numTraining; i++) {
+            int64_t centroid = previousLabels[i];
+            counts[centroid]++;
+            for (uint32_t d = 0; d < dimensions; d++)
+                sums[centroid * dimensions + d] += trainingData[static_cast<size_t>(i) * dimensions + d];
+        }
+
+        std::uniform_int_distribution<uint32_t> randomPoint(0, numTraining - 1);
+        for (uint32_t c = 0; c < numCentroids; c++) {
+            if (counts[c] == 0) {
+                // An empty cluster is restarted at a random training point
+                std::copy_n(trainingData.data() + static_cast<size_t>(randomPoint(generator)) * dimensions, dimensions, centroids.data() + static_cast<size_t>(c) * dimensions);
+                continue;
+            }
+            for (uint32_t d = 0; d < dimensions; d++)
+                centroids[static_cast<size_t>(c) * dimensions + d] = static_cast<float>(sums[static_cast<size_t>(c) * dimensions + d] / counts[c]);
+        }
+    }
+
+    // Assign all points to their final centroid
+    centroidIndex.build(centroids.data(), numCentroids, dimensions);
+    std::vector<uint32_t> assignments(numPoints);
+    std::vector<int64_t> chunkLabels(std::min(numPoints, _assignmentChunk));
+    std::vector<float> chunkDistances(chunkLabels.size());
+    for (uint32_t first = 0; first < numPoints; first += _assignmentChunk) {
+        if (cancelled && *cancelled)
+            return;
+
+        uint32_t count = std::min(_assignmentChunk, numPoints - first);
+        centroidIndex.search(data + static_cast<size_t>(first) * dimensions, count, dimensions, 1, chunkDistances.data(), chunkLabels.data());
+        for (uint32_t i = 0; i < count; i++)
+            assignments[first + i] = static_cast<uint32_t>(chunkLabels[i]);
+    }
+
+    _centroids = std::move(centroids);
+    _assignments = std::move(assignments);
+    _numCentroids = numCentroids;
+    _dimensions = dimensions;
+}
+
+void KMeansCodebook::clear()
+{
+    _centroids.clear();
+    _centroids.shrink_to_fit();
+    _assignments.clear();
+    _assignments.shrink_to_fit();
+    _numCentroids = 0;
+}
+
+void KMeansCodebook::computeCentroidPositions(const std::vector<float>& positionData, std::vector<float>& centroidPositions) const
+{
+    std::vector<double> sums(static_cast<size_t>(_numCentroids) * 2, 0.0);
+    std::vector<uint32_t> counts(_numCentroids, 0);
+
+    for (size_t point = 0; point < _assignments.size(); point++) {
+        uint32_t centroid = _assignments[point];
+        sums[centroid * 2] += positionData[point * 2];
+        sums[centroid * 2 + 1] += positionData[point * 2 + 1];
+        counts[centroid]++;
+    }
+
+    centroidPositions.assign(static_cast<size_t>(_numCentroids) * 2, 0.0f);
+    for (uint32_t c = 0; c < _numCentroids; c++) {
+        if (counts[c] == 0)
+            continue;
+        centroidPositions[c * 2] = static_cast<float>(sums[c * 2] / counts[c]);
+        centroidPositions[c * 2 + 1] = static_cast<float>(sums[c * 2 + 1] / counts[c]);
+    }
+}
+
+// Must stay in sync with FullDataCodebookLookup.comp: same centroid order, same accumulation order, no fused multiply-add
+uint32_t KMeansCodebook::nearestCentroid(const float* vector) const
+{
+    float bestDistance = std::numeric_limits<float>::max();
+    uint32_t bestCentroid = 0;
+
+    for (uint32_t c = 0; c < _numCentroids; c++) {
+        const float* centroid = _centroids.data() + static_cast<size_t>(c) * _dimensions;
+        float distance = 0.0f;
+        for (uint32_t d = 0; d < _dimensions; d++) {
+            float diff = vector[d] - centroid[d];
+            distance += diff * diff;
+        }
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            bestCentroid = c;
+        }
+    }
+    return bestCentroid;
+}
+
+void KMeansCodebook::mapSamples(const float* samples, int64_t numSamples, const std::vector<float>& centroidPositions, float* positions) const
+{
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < numSamples; i++) {
+        uint32_t centroid = nearestCentroid(samples + i * _dimensions);
+        positions[i * 2] = centroidPositions[centroid * 2];
+        positions[i * 2 + 1] = centroidPositions[centroid * 2 + 1];
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Compact codebook of the voxel vectors, built with k-means.
+ *
+ * Every voxel is assigned to its nearest centroid, the embedding position of a centroid is the mean 2D position
+ * of its voxels. A sample is then mapped to the position of its nearest centroid, which is cheap enough to run
+ * in a compute shader (FullDataCodebookLookup.comp) on the samples that never leave the GPU.
+ *
+ * mapSamples() is the CPU implementation of that shader. Both compare the centroids in the same order with the
+ * same (unfused) arithmetic, so for normal floating point values they select the same centroid and produce
+ * bit-identical positions. This file is compiled without floating point contraction for that reason.
+ */
+class KMeansCodebook
+{
+public:
+    /**
+     * Clusters the data with k-means (Lloyd iterations on a random subset) and assigns every point to its nearest centroid
+     * @param data Flat data, each point is (dimensions) floats
+     * @param numPoints Number of points
+     * @param dimensions Dimensionality of a single point
+     * @param numCentroids Number of centroids (clamped to the number of points)
+     * @param iterations Maximum number of Lloyd iterations
+     * @param cancelled Optional flag that aborts the construction when set, the codebook is left empty
+     */
+    void build(const float* data, uint32_t numPoints, uint32_t dimensions, uint32_t numCentroids, int iterations, const std::atomic<bool>* cancelled = nullptr);
+
+    /** Frees the centroids and assignments */
+    void clear();
+
+    bool isBuilt() const { return _numCentroids > 0; }
+    uint32_t getNumCentroids() const { return _numCentroids; }
+    uint32_t getDimensions() const { return _dimensions; }
+
+    /** Centroids, each centroid is (dimensions) floats */
+    const std::vector<float>& getCentroids() const { return _centroids; }
+
+    /** Returns the size of the centroids and assignments in bytes */
+    size_t getMemorySize() const { return _centroids.size() * sizeof(float) + _assignments.size() * sizeof(uint32_t); }
+
+    /**
+     * Computes the embedding position of every centroid as the mean position of the points assigned to it
+     * @param positionData Two floats per point
+     * @param centroidPositions Output: two floats per centroid, centroids without points get position (0, 0)
+     */
+    void computeCentroidPositions(const std::vector<float>& positionData, std::vector<float>& centroidPositions) const;
+
+    /** Index of the centroid nearest to the vector, ties go to the lowest index */
+    uint32_t nearestCentroid(const float* vector) const;
+
+    /**
+     * Maps samples to the position of their nearest centroid, the CPU equivalent of FullDataCodebookLookup.comp
+     * @param samples Flat sample data, each sample is (dimensions) floats
+     * @param numSamples Number of samples
+     * @param centroidPositions Two floats per centroid (see computeCentroidPositions)
+     * @param positions Output: two floats per sample
+     */
+    void mapSamples(const float* samples, int64_t numSamples, const std::vector<float>& centroidPositions, float* positions) const;
+
+private:
+    static constexpr uint32_t   _maxTrainingPoints = 1 << 17;   // The Lloyd iterations run on a random subset of at most this many points
+    static constexpr uint32_t   _assignmentChunk = 1 << 20;     // Points that are assigned between two checks of the cancel flag
+
+    std::vector<float>          _centroids;                     // numCentroids * dimensions floats
+    std::vector<uint32_t>       _assignments;                   // Nearest centroid of every point
+    uint32_t                    _numCentroids = 0;
+    uint32_t                    _dimensions = 0;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <hnswlib/hnswlib.h>
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * hnswlib space that stores every vector with one byte per channel (int8 scalar quantization).
+ *
+ * Each channel is quantized linearly between its minimum and maximum value in the data, the distance is the
+ * squared L2 distance between the reconstructed vectors. This reduces the vector storage of the index by 4x
+ * compared to the float L2Space. Both the inserted points and the queries need to be quantized with quantize()
+ * before they are passed to the index.
+ */
+class ScalarQuantizedL2Space : public hnswlib::SpaceInterface<float>
+{
+public:
+    /**
+     * Establishes the quantization range of every channel
+     * @param data Flat data, each point is (dimensions) floats
+     * @param numPoints Number of points
+     * @param dimensions Dimensionality of a single point
+     */
+    ScalarQuantizedL2Space(const float* data, size_t numPoints, size_t dimensions) :
+        _minimums(dimensions, std::numeric_limits<float>::max()),
+        _invScales(dimensions, 0.0f)
+    {
+        _parameters.dimensions = dimensions;
+        _parameters.squaredScales.resize(dimensions);
+
+        std::vector<float> maximums(dimensions, std::numeric_limits<float>::lowest());
+
+        #pragma omp parallel
+        {
+            std::vector<float> localMinimums(dimensions, std::numeric_limits<float>::max());
+            std::vector<float> localMaximums(dimensions, std::numeric_limits<float>::lowest());
+
+            #pragma omp for schedule(static)
+            for (int64_t i = 0; i < static_cast<int64_t>(numPoints); i++) {
+                for (size_t d = 0; d < dimensions; d++) {
+                    localMinimums[d] = std::min(localMinimums[d], data[i * dimensions + d]);
+                    localMaximums[d] = std::max(localMaximums[d], data[i * dimensions + d]);
+                }
+            }
+
+            #pragma omp critical
+            for (size_t d = 0; d < dimensions; d++) {
+                _minimums[d] = std::min(_minimums[d], localMinimums[d]);
+                maximums[d] = std::max(maximums[d], localMaximums[d]);
+            }
+        }
+
+        for (size_t d = 0; d < dimensions; d++) {
+            float scale = (maximums[d] - _minimums[d]) / 255.0f;
+            _invScales[d] = scale > 0.0f ? 1.0f / scale : 0.0f; // Constant channels are all quantized to 0
+            _parameters.squaredScales[d] = scale * scale;
+        }
+    }
+
+    size_t get_data_size() override { return _parameters.dimensions; }
+    hnswlib::DISTFUNC<float> get_dist_func() override { return &distance; }
+    void* get_dist_func_param() override { return &_parameters; }
+
+    size_t getDimensions() const { return _parameters.dimensions; }
+
+    /** Quantizes a float vector into (dimensions) bytes, values outside the data range are clamped */
+    void quantize(const float* vector, uint8_t* codes) const
+    {
+        for (size_t d = 0; d < _parameters.dimensions; d++) {
+            float code = (vector[d] - _minimums[d]) * _invScales[d] + 0.5f;
+            codes[d] = static_cast<uint8_t>(std::clamp(code, 0.0f, 255.0f));
+        }
+    }
+
+private:
+    struct Parameters {
+        size_t              dimensions = 0;
+        std::vector<float>  squaredScales;      // Squared size of one quantization step per channel
+    };
+
+    static float distance(const void* a, const void* b, const void* parameters)
+    {
+        auto* codesA = static_cast<const uint8_t*>(a);
+        auto* codesB = static_cast<const uint8_t*>(b);
+        auto* p = static_cast<const Parameters*>(parameters);
+
+        const float* squaredScales = p->squaredScales.data();
+        const size_t dimensions = p->dimensions;
+        size_t d = 0;
+        float result = 0.0f;
+
+        // The codes are widened to 32 bit integers, subtracted and weighted in float, 16 (AVX-512) or 8 (AVX2) channels at a time
+#if defined(__AVX512F__)
+        __m512 acc = _mm512_setzero_ps();
+        for (; d + 16 <= dimensions; d += 16) {
+            __m512i codesLeft = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codesA + d)));
+            __m512i codesRight = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codesB + d)));
+            __m512 diff = _mm512_cvtepi32_ps(_mm512_sub_epi32(codesLeft, codesRight));
+            acc = _mm512_fmadd_ps(_mm512_mul_ps(diff, diff), _mm512_loadu_ps(squaredScales + d), acc);
+        }
+        result = _mm512_reduce_add_ps(acc);
+#elif defined(__AVX2__)
+        __m256 acc = _mm256_setzero_ps();
+        for (; d + 8 <= dimensions; d += 8) {
+            __m256i codesLeft = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(codesA + d)));
+            __m256i codesRight = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(codesB + d)));
+            __m256 diff = _mm256_cvtepi32_ps(_mm256_sub_epi32(codesLeft, codesRight));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_mul_ps(diff, diff), _mm256_loadu_ps(squaredScales + d)));
+        }
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        result = _mm_cvtss_f32(sum);
+#endif
+
+        // Remaining channels, and all of them without AVX
+        for (; d < dimensions; d++) {
+            float diff = static_cast<float>(static_cast<int>(codesA[d]) - static_cast<int>(codesB[d]));
+            result += diff * diff * squaredScales[d];
+        }
+        return result;
+    }
+
+    Parameters          _parameters;
+    std::vector<float>  _minimums;
+    std::vector<float>  _invScales;     // Quantization steps per unit per channel
+};
@@ -6,6 +6,11 @@
 #include <algorithm>
 #include <numeric>
 #include <sstream> 
+#include <chrono>
+#include <array>
+#include <cmath>
+#include <QFile>
+#include <QOpenGLContext>
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -22,6 +27,9 @@ void VolumeRenderer::init()
     _volumeTexture.create();
     _volumeTexture.initialize();
 
+    _voxelEmbeddingTexture.create();
+    _voxelEmbeddingTexture.initialize();
+
     // Initialize the transfer function textures
     _tfTexture.create();
     _tfTexture.bind();
@@ -99,32 +107,58 @@ void VolumeRenderer::init()
     _framebuffer.bind();
     _framebuffer.validate();
 
-    // Initialize the volume shader program
+    // The ray ID texture of the full data modes, it gets its size in resize() and is cleared through its own framebuffer
+    _fullDataArena.rayIDTexture.create();
+    _fullDataArena.rayIDTexture.bind();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    _fullDataArena.rayIDFramebuffer.create();
+    _fullDataArena.rayIDFramebuffer.bind();
+    _fullDataArena.rayIDFramebuffer.setTexture(GL_COLOR_ATTACHMENT0, _fullDataArena.rayIDTexture);
+    _fullDataArena.rayIDFramebuffer.release();
+
+    // The sample limits of the early ray termination, also sized in resize()
+    _fullDataArena.sampleLimitTexture.create();
+    _fullDataArena.sampleLimitTexture.bind();
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Uniform buffer with the per-frame state that all render mode programs share, it stays bound to its binding point and
+    // every program links its FrameState block to that binding point (see CachedShaderProgram). updateFrameState fills it once per frame.
+    glGenBuffers(1, &_frameStateUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, _frameStateUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameState), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CachedShaderProgram::FrameStateBinding, _frameStateUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // The surface and texture shaders are used by every render mode, the shaders of the render modes themselves are only compiled
+    // when the mode is used for the first time (see loadRenderModeShaders), or in the background by warmUpNextShader.
+    // The programs come from the program binary cache when they were linked before with the same driver.
+    auto shaderStart = std::chrono::steady_clock::now();
     bool loaded = true;
     loaded &= _surfaceShader.loadShaderFromFile(":shaders/Surface.vert", ":shaders/Surface.frag");
-    loaded &= _2DCompositeShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/2DComposite.frag");
-    loaded &= _colorCompositeShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/ColorComposite.frag");
-    loaded &= _1DMipShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/1DMip.frag");
-    loaded &= _materialTransition2DShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/MaterialTransition2D.frag");
-    loaded &= _nnMaterialTransitionShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/NNMaterialTransition.frag");
-    loaded &= _altNNMaterialTransitionShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/AltNNMaterialTransition.frag");
-    loaded &= _fullDataCompositeShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/FullDataCompositeBlending.frag");
-    loaded &= _fullDataMaterialTransitionShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/FullDataMaterialBlending.frag");
     loaded &= _textureShader.loadShaderFromFile(":shaders/QuadDVR.vert", ":shaders/Texture.frag");
+    _2DCompositeShader.setSourceFiles(":shaders/QuadDVR.vert", ":shaders/2DComposite.frag");
+    _colorCompositeShader.setSourceFiles(":shaders/QuadDVR.vert", ":shaders/ColorComposite.frag");
+    _1DMipShader.setSourceFiles(":shaders/QuadDVR.vert", ":shaders/1DMip.frag");
+    _materialTransition2DShader.setSourceFiles(":shaders/QuadDVR.vert", ":shaders/MaterialTransition2D.frag");
+    _nnMaterialTransitionShader.setSourceFiles(":shaders/QuadDVR.vert", ":shaders/NNMaterialTransition.frag");
+    _altNNMaterialTransitionShader.setSourceFiles(":shaders/QuadDVR.vert", ":shaders/AltNNMaterialTransition.frag");
+    _fullDataCompositeShader.setSourceFiles(":shaders/QuadDVR.vert", ":shaders/FullDataCompositeBlending.frag");
+    _fullDataMaterialTransitionShader.setSourceFiles(":shaders/QuadDVR.vert", ":shaders/FullDataMaterialBlending.frag");
 
     if (!loaded) {
         qCritical() << "Failed to load one of the Volume Renderer shaders";
     }
     else {
-        qDebug() << "Volume Renderer shaders loaded";
-    }
-
-    // Create the shader program instance.
-    _fullDataSamplerComputeShader = new QOpenGLShaderProgram();
-    if (!_fullDataSamplerComputeShader->addShaderFromSourceFile(QOpenGLShader::Compute, ":shaders/FullDataSampling.comp"))
-    {
-        qCritical() << "Failed to load compute shader:" << _fullDataSamplerComputeShader->log();
-        return;
+        qDebug() << "Volume Renderer shaders loaded in" << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStart).count() << "ms";
     }
 
     // Initialize the Marching Cubes edge and triangle tables for the smoothing in the NN rendering modes 
@@ -219,6 +253,95 @@ void VolumeRenderer::init()
 }
 
 
+// The shader programs a render mode draws with, besides the surface and texture shaders that every mode uses
+std::vector<CachedShaderProgram*> VolumeRenderer::getRenderModeShaders(RenderMode mode)
+{
+    switch (mode) {
+    case RenderMode::MULTIDIMENSIONAL_COMPOSITE_FULL:
+    case RenderMode::MaterialTransition_FULL:
+        return { &_fullDataCompositeShader, &_fullDataMaterialTransitionShader };
+    case RenderMode::MULTIDIMENSIONAL_COMPOSITE_2D_POS:
+        return { &_2DCompositeShader };
+    case RenderMode::MULTIDIMENSIONAL_COMPOSITE_COLOR:
+    case RenderMode::NN_MULTIDIMENSIONAL_COMPOSITE:
+        return { &_colorCompositeShader };
+    case RenderMode::MIP:
+        return { &_1DMipShader };
+    case RenderMode::NN_MaterialTransition:
+    case RenderMode::Smooth_NN_MaterialTransition:
+        return { &_nnMaterialTransitionShader };
+    case RenderMode::Alt_NN_MaterialTransition:
+        return { &_altNNMaterialTransitionShader };
+    case RenderMode::MaterialTransition_2D:
+        return { &_materialTransition2DShader };
+    default:
+        return {};
+    }
+}
+
+// Compiles (or loads from the binary cache) the shaders of a render mode the first time it is rendered
+bool VolumeRenderer::loadRenderModeShaders(RenderMode mode)
+{
+    bool loaded = true;
+    for (CachedShaderProgram* shader : getRenderModeShaders(mode))
+        loaded &= shader->ensureLoaded();
+
+    if (mode == RenderMode::MULTIDIMENSIONAL_COMPOSITE_FULL || mode == RenderMode::MaterialTransition_FULL)
+        loaded &= loadFullDataComputeShaders();
+
+    return loaded;
+}
+
+bool VolumeRenderer::loadFullDataComputeShaders()
+{
+    // Only the first call loads the shaders, later calls return its result (a program that failed to link stays allocated until destroy)
+    if (_fullDataComputeShadersLoaded)
+        return _fullDataComputeShadersValid;
+    _fullDataComputeShadersLoaded = true;
+
+    _fullDataSamplerComputeShader = loadSamplingShader(_samplingRaysPerGroup, _samplingThreadsPerRay);
+    if (!_fullDataSamplerComputeShader)
+        return false;
+
+    _codebookLookupComputeShader = new QOpenGLShaderProgram();
+    if (!loadCachedComputeShader(*_codebookLookupComputeShader, ":shaders/FullDataCodebookLookup.comp"))
+        return false;
+
+    _rayIDScatterComputeShader = new QOpenGLShaderProgram();
+    if (!loadCachedComputeShader(*_rayIDScatterComputeShader, ":shaders/FullDataRayIDScatter.comp"))
+        return false;
+
+    _opacityEstimateComputeShader = new QOpenGLShaderProgram();
+    if (!loadCachedComputeShader(*_opacityEstimateComputeShader, ":shaders/FullDataOpacityEstimate.comp"))
+        return false;
+
+    _fullDataComputeShadersValid = true;
+    return true;
+}
+
+// Background warm-up, called from an idle timer of the widget with the context current.
+// Every call links a single program such that the warm-up never blocks the interaction for long.
+bool VolumeRenderer::warmUpNextShader()
+{
+    if (!_useShaderWarmUp)
+        return false;
+
+    for (CachedShaderProgram* shader : { &_2DCompositeShader, &_colorCompositeShader, &_1DMipShader, &_materialTransition2DShader, &_nnMaterialTransitionShader,
+                                         &_altNNMaterialTransitionShader, &_fullDataCompositeShader, &_fullDataMaterialTransitionShader }) {
+        if (shader->isPending()) {
+            shader->ensureLoaded();
+            return true;
+        }
+    }
+
+    if (!_fullDataComputeShadersLoaded) {
+        loadFullDataComputeShaders();
+        return true;
+    }
+
+    return false;
+}
+
 void VolumeRenderer::resize(QSize renderSize)
 {
 
@@ -237,6 +360,12 @@ void VolumeRenderer::resize(QSize renderSize)
     _adaptedScreenSizeTexture.bind();
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, _adjustedScreenSize.width(), _adjustedScreenSize.height(), 0, GL_RGB, GL_FLOAT, nullptr);
 
+    _fullDataArena.rayIDTexture.bind();
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, _adjustedScreenSize.width(), _adjustedScreenSize.height(), 0, GL_RED_INTEGER, GL_INT, nullptr);
+
+    _fullDataArena.sampleLimitTexture.bind();
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, _adjustedScreenSize.width(), _adjustedScreenSize.height(), 0, GL_RED_INTEGER, GL_INT, nullptr);
+
     _depthTexture.bind();
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, _adjustedScreenSize.width(), _adjustedScreenSize.height(), 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 
@@ -248,7 +377,11 @@ void VolumeRenderer::setData(const mv::Dataset<Volumes>& dataset)
 {
     _volumeDataset = dataset;
     _volumeSize = dataset->getVolumeSize().toVector3f();
+    cancelANNBuild(); // An index that is still being built belongs to the previous dataset
     _ANNAlgorithmTrained = false; // We need to retrain the ANN algorithm as the data has changed
+    _annBuildFailed = false;
+    _voxelEmbeddingStale = true;
+    invalidateRayCache();
     _fullDataMemorySize = _volumeSize.x * _volumeSize.y * _volumeSize.z * _volumeDataset->getComponentsPerVoxel() * sizeof(float); // in bytes
     if (_fullGPUMemorySize - _fullDataMemorySize < 0)
     {
@@ -263,34 +396,75 @@ void VolumeRenderer::setData(const mv::Dataset<Volumes>& dataset)
 void VolumeRenderer::setTfTexture(const mv::Dataset<Images>& tfTexture)
 {
     _tfDataset = tfTexture;
-    QSize textureDims = _tfDataset->getImageSize();
-    int dataSize = textureDims.width() * textureDims.height() * 4;
-    _tfImage = QVector<float>(dataSize);
-    QPair<float, float> scalarDataRange;
-    _tfDataset->getImageScalarData(0, _tfImage, scalarDataRange);
 
-    _scalarImageDataRange = scalarDataRange;
+    // When the transfer function widget shares its texture it is copied on the GPU, the CPU copy is only read back by the render modes that need it
+    // Both paths leave out the last row of the dataset image, such that the shader samples the same texels whichever path was taken
+    SharedTextureState sharedState = updateFromSharedTexture(_tfDataset, _tfTexture, GL_RGBA32F, _tfTextureVersion, 1);
+    if (sharedState == SharedTextureState::Unchanged)
+        return;
 
-    _tfTexture.bind();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, textureDims.width(), textureDims.height() - 1, 0, GL_RGBA, GL_FLOAT, _tfImage.data());
-    _tfTexture.release();
+    if (sharedState == SharedTextureState::Updated) {
+        _tfImageStale = true;
+    }
+    else {
+        QSize textureDims = _tfDataset->getImageSize();
+        int dataSize = textureDims.width() * textureDims.height() * 4;
+        _tfImage = QVector<float>(dataSize);
+        QPair<float, float> scalarDataRange;
+        _tfDataset->getImageScalarData(0, _tfImage, scalarDataRange);
+        _tfImageStale = false;
+
+        _scalarImageDataRange = scalarDataRange;
+
+        _tfTexture.bind();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, textureDims.width(), textureDims.height() - 1, 0, GL_RGBA, GL_FLOAT, _tfImage.data());
+        _tfTexture.release();
+    }
 
-    // In these rendermodes the new dataset will impact the visualization and thus needs to be updated now 
+    // In these rendermodes the new dataset will impact the visualization, the data texture is rebuilt by the next frame
+    // so that any number of changes in between cost a single rebuild
     if (_renderMode == RenderMode::MULTIDIMENSIONAL_COMPOSITE_COLOR || _renderMode == RenderMode::NN_MULTIDIMENSIONAL_COMPOSITE || _renderMode == RenderMode::NN_MaterialTransition || _renderMode == RenderMode::Alt_NN_MaterialTransition || _renderMode == RenderMode::Smooth_NN_MaterialTransition)
-        updataDataTexture();
+        _dataSettingsChanged = true;
 }
 
 void VolumeRenderer::setReducedPosData(const mv::Dataset<Points>& reducedPosData)
 {
     _reducedPosDataset = reducedPosData;
-    if (!_renderMode == RenderMode::MULTIDIMENSIONAL_COMPOSITE_FULL && !_renderMode == RenderMode::MaterialTransition_FULL && _renderMode != RenderMode::MIP) {
-        updataDataTexture(); // The position data is used in the rendering process, so we need to update the data texture (apart from the MIP and full data render modes that either don't need it or define it elsewhere)
+    invalidateRayCache(); // The cached results are positions in this dataset
+    _voxelEmbeddingStale = true;
+    if (_renderMode != RenderMode::MULTIDIMENSIONAL_COMPOSITE_FULL && _renderMode != RenderMode::MaterialTransition_FULL && _renderMode != RenderMode::MIP) {
+        _dataSettingsChanged = true; // The position data is used in the rendering process, so the data texture is rebuilt by the next frame (apart from the MIP and full data render modes that either don't need it or define it elsewhere)
     }
 }
 
 void VolumeRenderer::setMaterialTransitionTexture(const mv::Dataset<Images>& materialTransitionData)
 {
     _materialTransitionDataset = materialTransitionData;
+
+    // The transfer function plugin describes every change of the table with a version and the changed texels (see TransferFunctionWidget),
+    // when this texture holds the previous version only those texels are uploaded. On a gap in the versions, a full change or a
+    // dataset without the properties the whole table is reloaded.
+    QVariant versionProperty = _materialTransitionDataset->property("materialTableVersion");
+    quint64 version = versionProperty.isValid() ? versionProperty.toULongLong() : 0;
+
+    if (version != 0 && version == _materialTransitionVersion)
+        return;
+
+    if (version != 0 && version == _materialTransitionVersion + 1) {
+        QRect dirtyTexels = _materialTransitionDataset->property("materialTableDirtyTexels").toRect();
+        QVector<float> dirtyData = _materialTransitionDataset->property("materialTableDirtyData").value<QVector<float>>();
+
+        if (dirtyTexels.isValid() && dirtyData.size() == dirtyTexels.width() * dirtyTexels.height() * 4) {
+            _materialTransitionTexture.bind();
+            glTexSubImage2D(GL_TEXTURE_2D, 0, dirtyTexels.x(), dirtyTexels.y(), dirtyTexels.width(), dirtyTexels.height(), GL_RGBA, GL_FLOAT, dirtyData.constData());
+            _materialTransitionTexture.release();
+            _materialTransitionVersion = version;
+            return;
+        }
+    }
+
+    _materialTransitionVersion = version;
+
     QSize textureDims = _materialTransitionDataset->getImageSize();
     QVector<float> transitionData = QVector<float>(textureDims.width() * textureDims.height() * 4);
     QPair<float, float> scalarDataRange;
@@ -304,16 +478,84 @@ void VolumeRenderer::setMaterialTransitionTexture(const mv::Dataset<Images>& mat
 void VolumeRenderer::setMaterialPositionTexture(const mv::Dataset<Images>& materialPositionTexture)
 {
     _materialPositionDataset = materialPositionTexture;
+
+    SharedTextureState sharedState = updateFromSharedTexture(_materialPositionDataset, _materialPositionTexture, GL_R32F, _materialPositionTextureVersion);
+    if (sharedState == SharedTextureState::Updated)
+        _materialPositionImageStale = true;
+    if (sharedState != SharedTextureState::Unavailable)
+        return;
+
     QSize textureDims = _materialPositionDataset->getImageSize();
     _materialPositionImage = QVector<float>(textureDims.width() * textureDims.height());
     QPair<float, float> scalarDataRange;
     _materialPositionDataset->getImageScalarData(0, _materialPositionImage, scalarDataRange);
+    _materialPositionImageStale = false;
 
     _materialPositionTexture.bind();
     glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, textureDims.width(), textureDims.height(), 0, GL_RED, GL_FLOAT, _materialPositionImage.data());
     _materialPositionTexture.release();
 }
 
+// droppedRows leaves out the last rows of the shared texture, to match a CPU upload that leaves them out as well
+VolumeRenderer::SharedTextureState VolumeRenderer::updateFromSharedTexture(const mv::Dataset<Images>& dataset, mv::Texture2D& target, GLenum internalFormat, quint64& version, int droppedRows)
+{
+    // The dynamic properties are set by SharedTextureCompositor of the transfer function plugin, the names have to match
+    GLuint sharedTexture = dataset->property("sharedGLTexture").toUInt();
+    auto* sharedContext = reinterpret_cast<QOpenGLContext*>(dataset->property("sharedGLTextureContext").value<quintptr>());
+    QOpenGLContext* currentContext = QOpenGLContext::currentContext();
+
+    if (sharedTexture == 0 || sharedContext == nullptr || currentContext == nullptr || !QOpenGLContext::areSharing(sharedContext, currentContext)) {
+        version = 0;
+        return SharedTextureState::Unavailable;
+    }
+
+    quint64 sharedVersion = dataset->property("sharedGLTextureVersion").toULongLong();
+    if (sharedVersion == version)
+        return SharedTextureState::Unchanged;
+
+    // The target keeps its own sampling parameters, only its storage has to match the shared texture for the copy
+    QSize textureDims = dataset->getImageSize() - QSize(0, droppedRows);
+    GLint width = 0, height = 0, format = 0;
+    target.bind();
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    if (width != textureDims.width() || height != textureDims.height() || format != static_cast<GLint>(internalFormat))
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, textureDims.width(), textureDims.height(), 0, internalFormat == GL_R32F ? GL_RED : GL_RGBA, GL_FLOAT, nullptr);
+    target.release();
+
+    glCopyImageSubData(sharedTexture, GL_TEXTURE_2D, 0, 0, 0, 0, target.getHandle(), GL_TEXTURE_2D, 0, 0, 0, 0, textureDims.width(), textureDims.height(), 1);
+
+    version = sharedVersion;
+    return SharedTextureState::Updated;
+}
+
+void VolumeRenderer::ensureTfImage()
+{
+    if (!_tfImageStale)
+        return;
+
+    QSize textureDims = _tfDataset->getImageSize();
+    _tfImage.resize(textureDims.width() * textureDims.height() * 4);
+    _tfTexture.bind();
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_FLOAT, _tfImage.data());
+    _tfTexture.release();
+    _tfImageStale = false;
+}
+
+void VolumeRenderer::ensureMaterialPositionImage()
+{
+    if (!_materialPositionImageStale)
+        return;
+
+    QSize textureDims = _materialPositionDataset->getImageSize();
+    _materialPositionImage.resize(textureDims.width() * textureDims.height());
+    _materialPositionTexture.bind();
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, _materialPositionImage.data());
+    _materialPositionTexture.release();
+    _materialPositionImageStale = false;
+}
+
 void VolumeRenderer::normalizePositionData(std::vector<float>& positionData)
 {
     float minX = std::numeric_limits<float>::max();
@@ -459,6 +701,7 @@ void VolumeRenderer::updataDataTexture()
             }
 
             _volumeTextureSize = _volumeSize;
+            ensureMaterialPositionImage();
             loadNNVolumeToTexture(_volumeTexture, _textureData, _materialPositionImage, _materialPositionDataset->getImageSize().width(), _volumeTextureSize, _volumeDataset->getNumberOfVoxels(), true);
         }
         else if (_renderMode == RenderMode::MULTIDIMENSIONAL_COMPOSITE_COLOR || _renderMode == RenderMode::NN_MULTIDIMENSIONAL_COMPOSITE) {
@@ -468,6 +711,7 @@ void VolumeRenderer::updataDataTexture()
             }
             
             _volumeTextureSize = _volumeSize;
+            ensureTfImage();
             loadNNVolumeToTexture(_volumeTexture, _textureData, _tfImage, _tfDataset->getImageSize().width(), _volumeTextureSize, _volumeDataset->getNumberOfVoxels(), false);
         }
         else if (_renderMode == RenderMode::MIP) {
@@ -522,8 +766,10 @@ void VolumeRenderer::setUseCustomRenderSpace(bool useCustomRenderSpace)
 // Which dimension should we send to the GPU (used for the full data and MIP render modes)
 void VolumeRenderer::setCompositeIndices(std::vector<std::uint32_t> compositeIndices)
 {
-    if (_compositeIndices != compositeIndices)
+    if (_compositeIndices != compositeIndices) {
         _dataSettingsChanged = true;
+        _annBuildFailed = false; // A failed index build may succeed with other channels
+    }
     _compositeIndices = compositeIndices;
 }
 
@@ -619,6 +865,8 @@ void VolumeRenderer::setRenderMode(const QString& renderMode)
 
     if (currentGroup != 1) {
         _fullDataModeBatch = -1; // We don't need to use the full data in these modes, so we reset the batch progress counter
+        if (getRenderModeGroup(_renderMode) == 1)
+            releaseFullDataArena(); // The full data render mode session ends
     }
 
     _renderMode = givenMode;
@@ -664,7 +912,33 @@ void VolumeRenderer::updateMatrices()
     _mvpMatrix = _camera.getProjectionMatrix() * _camera.getViewMatrix() * _modelMatrix;
 }
 
-void VolumeRenderer::drawDVRRender(mv::ShaderProgram& shader)
+void VolumeRenderer::updateFrameState()
+{
+    // The values the render modes used to set per program by name, the layout follows the std140 FrameState block of the shaders
+    FrameState state = {};
+    std::copy_n(_mvpMatrix.constData(), 16, state.modelViewProjection);
+    std::copy_n(_modelMatrix.constData(), 16, state.model);
+
+    mv::Vector3f dimensions = _useCustomRenderSpace ? _renderSpace : _volumeSize;
+    auto setVec3 = [](float* target, const mv::Vector3f& value) { target[0] = value.x; target[1] = value.y; target[2] = value.z; };
+    setVec3(state.minClippingPlane, _minClippingPlane);
+    setVec3(state.maxClippingPlane, _maxClippingPlane);
+    setVec3(state.dimensions, dimensions);
+    setVec3(state.invDimensions, mv::Vector3f(1.0f / dimensions.x, 1.0f / dimensions.y, 1.0f / dimensions.z));
+    setVec3(state.renderCubeSize, mv::Vector3f(_renderCubeSize / _volumeSize.x, _renderCubeSize / _volumeSize.y, _renderCubeSize / _volumeSize.z));
+    setVec3(state.camPos, _cameraPos);
+    setVec3(state.lightPos, _cameraPos); // The light is attached to the camera
+    state.stepSize = _stepSize;
+    state.invFaceTexSize[0] = 1.0f / _adjustedScreenSize.width();
+    state.invFaceTexSize[1] = 1.0f / _adjustedScreenSize.height();
+
+    glBindBuffer(GL_UNIFORM_BUFFER, _frameStateUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameState), &state);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CachedShaderProgram::FrameStateBinding, _frameStateUBO); // Another renderer in the same context may have taken the binding point
+}
+
+void VolumeRenderer::drawDVRRender(CachedShaderProgram& shader)
 {
     _vboCube.bind();
     _iboCube.bind();
@@ -674,24 +948,15 @@ void VolumeRenderer::drawDVRRender(mv::ShaderProgram& shader)
     glBindTexture(GL_TEXTURE_BUFFER, _renderCubePositionsTexID);
     shader.uniform1i("renderCubePositions", 5);
 
-    shader.uniformMatrix4f("u_modelViewProjection", _mvpMatrix.constData());
-    shader.uniformMatrix4f("u_model", _modelMatrix.constData());
-    shader.uniform3fv("u_minClippingPlane", 1, &_minClippingPlane);
-    shader.uniform3fv("u_maxClippingPlane", 1, &_maxClippingPlane);
-
-    mv::Vector3f renderCubeSize = mv::Vector3f(_renderCubeSize / _volumeSize.x, _renderCubeSize / _volumeSize.y, _renderCubeSize / _volumeSize.z);
-    shader.uniform3fv("renderCubeSize", 1, &renderCubeSize);
+    // The matrices, clipping planes and render cube size come from the FrameState uniform block (see updateFrameState)
 
     // The actual rendering step
     _vao.bind();
     glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, _renderCubeAmount);
 }
 
-void VolumeRenderer::drawDVRQuad(mv::ShaderProgram& shader)
+void VolumeRenderer::drawDVRQuad(CachedShaderProgram& shader)
 {
-    shader.uniform3fv("u_minClippingPlane", 1, &_minClippingPlane);
-    shader.uniform3fv("u_maxClippingPlane", 1, &_maxClippingPlane);
-
     _vboQuad.bind();
     _iboQuad.bind();
     _vao.bind();
@@ -744,15 +1009,63 @@ void VolumeRenderer::prepareANN()
         return;
     }
 
+    // A build that is still running works on outdated data, so it is cancelled before a new one is started
+    cancelANNBuild();
+    _ANNAlgorithmTrained = false;
+    invalidateRayCache(); // Results of a previous index may differ from the ones of the new index
+
     uint32_t numVoxels = _volumeDataset->getNumberOfVoxels();
     uint32_t dimensions = _volumeDataset->getComponentsPerVoxel();
 
-    // Populate ANN index with volume data.
-    std::vector<float> voxelData(dimensions * numVoxels);
+    // The backend is picked here, the worker thread only reads it
+    _annBackend = selectANNBackend(numVoxels, dimensions, estimateFullDataQueries());
+
+    // Populate ANN index with volume data. The dataset is only accessed here on the GUI thread, the construction of the index itself happens on a worker thread.
+    std::vector<float> voxelData(static_cast<size_t>(dimensions) * numVoxels);
     QPair<float, float> scalarDataRange;
     _volumeDataset->getVolumeData(_compositeIndices, voxelData, scalarDataRange);
+
+    _annBuildCancelled = false;
+    _annBuildTask = std::async(std::launch::async, [this, voxelData = std::move(voxelData), numVoxels, dimensions]() mutable {
+        try {
+            buildANNIndex(voxelData, numVoxels, dimensions);
+
+            // The re-ranking takes over the vectors the index was built from, so there is never a second float copy of the volume
+            if (_quantizedSpace && _quantizedRerankFactor > 1)
+                _rerankVectors = std::move(voxelData);
+
+            // Publishes the index, the release store makes all writes of the build visible to the thread that sees the flag
+            if (!_annBuildCancelled)
+                _ANNAlgorithmTrained.store(true, std::memory_order_release);
+        }
+        catch (const std::exception& e) {
+            qCritical() << "Failed to build the ANN index:" << e.what();
+        }
+    });
+}
+
+// Builds (or loads) the ANN index, this runs on a worker thread so it must not touch any OpenGL or dataset state
+void VolumeRenderer::buildANNIndex(const std::vector<float>& voxelData, uint32_t numVoxels, uint32_t dimensions)
+{
+    auto buildStart = std::chrono::steady_clock::now();
+
+    if (_annBackend == ANNBackend::Codebook) {
+        _hnswIndex.reset();
+        _bruteForceIndex.clear();
+        _codebook.build(voxelData.data(), numVoxels, dimensions, _codebookSize, _codebookIterations, &_annBuildCancelled);
+        if (_annBuildCancelled)
+            return;
+        qDebug() << "Codebook with" << _codebook.getNumCentroids() << "centroids prepared for" << numVoxels << "voxels (" << _codebook.getMemorySize() / (1024 * 1024) << "MB)";
+    }
+    else if (_annBackend == ANNBackend::BruteForce) {
+        _hnswIndex.reset(); // The previous index is not needed anymore, free its memory
+        _codebook.clear();
+        _bruteForceIndex.build(voxelData.data(), numVoxels, dimensions);
+        qDebug() << "Exact kNN backend (" << BruteForceKnn::getInstructionSet() << ") prepared for" << numVoxels << "voxels with" << dimensions << "channels";
+    }
+    else
 #ifdef USE_FAISS
-    if (_useFaissANN) {
+    if (_annBackend == ANNBackend::Faiss) {
         _nlist = std::clamp(static_cast<int>(numVoxels / 1000), 32, 4096); // nlist is the number of clusters in Faiss
         //_nprobe = std::clamp(static_cast<int>(numVoxels / 1000000), 1, 64); // nprobe is the number of clusters to search in Faiss
 
@@ -768,6 +1081,9 @@ void VolumeRenderer::prepareANN()
     else
 #endif  
     {
+            _bruteForceIndex.clear();
+            _codebook.clear();
+
             // Build a filename referencing key parameters
             std::ostringstream oss;
             oss << _hnswIndexFolder << "hnsw_index"
@@ -775,11 +1091,22 @@ void VolumeRenderer::prepareANN()
                 << "_efC" << _hnswEfConstruction
                 << "_dim" << dimensions
                 << "_voxNum" << numVoxels
+                << (_useQuantizedANN ? "_sq8" : "")
                 << ".bin";
             std::string indexPath = oss.str();
 
-            // Initialize HNSW space
-            _hnswSpace = std::make_unique<hnswlib::L2Space>(dimensions);
+            // Initialize HNSW space, the quantized space stores one byte per channel instead of a float
+            _quantizedSpace = nullptr;
+            _rerankVectors.clear();
+            if (_useQuantizedANN) {
+                auto quantizedSpace = std::make_unique<ScalarQuantizedL2Space>(voxelData.data(), numVoxels, dimensions);
+                _quantizedSpace = quantizedSpace.get();
+                _hnswSpace = std::move(quantizedSpace);
+
+            }
+            else {
+                _hnswSpace = std::make_unique<hnswlib::L2Space>(dimensions);
+            }
 
             if (std::filesystem::exists(indexPath)) {
                 // Load existing index
@@ -795,8 +1122,39 @@ void VolumeRenderer::prepareANN()
                     _hnswM,
                     _hnswEfConstruction
                 );
-                for (uint32_t i = 0; i < numVoxels; ++i) {
-                    _hnswIndex->addPoint(voxelData.data() + i * dimensions, i);
+
+                // hnswlib supports concurrent inserts (it locks per element), so the voxels are inserted by all cores at once.
+                // Progress is reported roughly every 5% together with the insertion throughput.
+                const int64_t reportInterval = std::max<int64_t>(numVoxels / 20, 1);
+                std::atomic<int64_t> insertedPoints = 0;
+
+                #pragma omp parallel
+                {
+                    std::vector<uint8_t> codes(_quantizedSpace ? dimensions : 0);
+
+                    #pragma omp for schedule(dynamic, 1024)
+                    for (int64_t i = 0; i < static_cast<int64_t>(numVoxels); ++i) {
+                        if (_annBuildCancelled) // we cannot break out of an OpenMP loop, so the remaining iterations are skipped instead
+                            continue;
+
+                        const void* point = voxelData.data() + i * dimensions;
+                        if (_quantizedSpace) {
+                            _quantizedSpace->quantize(voxelData.data() + i * dimensions, codes.data());
+                            point = codes.data();
+                        }
+                        _hnswIndex->addPoint(point, static_cast<hnswlib::labeltype>(i));
+
+                        int64_t inserted = ++insertedPoints;
+                        if (inserted % reportInterval == 0) {
+                            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+                            qDebug() << "HNSW index construction:" << (100 * inserted) / numVoxels << "% -" << static_cast<int64_t>(inserted / std::max(seconds, 1e-6)) << "points/s";
+                        }
+                    }
+                }
+
+                if (_annBuildCancelled) {
+                    qDebug() << "HNSW index construction cancelled.";
+                    return;
                 }
                 _hnswIndex->setEf(_hwnsEfSearch);
 
@@ -808,7 +1166,267 @@ void VolumeRenderer::prepareANN()
                     qCritical() << "Failed to save HNSW index:" << e.what();
                 }
             }
+
+            // The float vectors that the re-ranking keeps are part of the memory of the index
+            const size_t rerankBytes = (_quantizedSpace && _quantizedRerankFactor > 1) ? voxelData.size() * sizeof(float) : 0;
+            qDebug() << "HNSW index memory:" << (_hnswIndex->indexFileSize() + rerankBytes) / (1024 * 1024) << "MB with" << (_quantizedSpace ? "int8" : "float") << "vectors";
+            if (rerankBytes > 0)
+                qDebug() << "HNSW index memory: of which" << rerankBytes / (1024 * 1024) << "MB are the float vectors of the re-ranking";
+        }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+    qDebug() << getANNBackendName() << "index ready after" << seconds << "s (" << static_cast<int64_t>(numVoxels / std::max(seconds, 1e-6)) << "points/s )";
+
+#ifdef DVR_ANN_BENCHMARK
+    benchmarkANNBackends(voxelData, numVoxels, dimensions);
+#endif
+}
+
+// Picks the nearest neighbour backend from the amount of work of a full data render.
+// The exact search compares every query with every voxel, HNSW pays for the construction of the graph once and then visits roughly
+// efSearch * M nodes per level of the graph for every query. Both costs are counted in distance computations (the number of channels
+// cancels out), the exact search is used when it is cheaper, as it has no approximation error.
+ANNBackend VolumeRenderer::selectANNBackend(uint32_t numVoxels, uint32_t dimensions, double expectedQueries) const
+{
+    if (_useCodebookSearch)
+        return ANNBackend::Codebook;
+#ifdef USE_FAISS
+    if (_useFaissANN)
+        return ANNBackend::Faiss;
+#endif
+    if (static_cast<size_t>(numVoxels) * dimensions > _bruteForceMaxElements)
+        return ANNBackend::HNSW;
+
+    const double levels = std::log2(std::max<uint32_t>(numVoxels, 2));
+    const double bruteForceCost = expectedQueries * numVoxels / _bruteForceSpeedup;
+    const double hnswCost = (static_cast<double>(numVoxels) * _hnswEfConstruction + expectedQueries * std::max(_hwnsEfSearch, 16) * _hnswM) * levels;
+
+    qDebug() << "ANN backend selection for about" << expectedQueries << "queries: exact search" << bruteForceCost << "vs HNSW" << hnswCost << "distance computations";
+
+    return bruteForceCost <= hnswCost ? ANNBackend::BruteForce : ANNBackend::HNSW;
+}
+
+// Number of kNN queries of a full data render when every pixel hits the volume. A ray through a convex body is on average 4 * volume / surface
+// long (Cauchy's mean chord length), and it takes a sample every step.
+double VolumeRenderer::estimateFullDataQueries() const
+{
+    const mv::Vector3f size = _useCustomRenderSpace ? _renderSpace : _volumeSize;
+    const double volume = static_cast<double>(size.x) * size.y * size.z;
+    const double surface = 2.0 * (static_cast<double>(size.x) * size.y + static_cast<double>(size.y) * size.z + static_cast<double>(size.x) * size.z);
+    const double meanRayLength = surface > 0.0 ? 4.0 * volume / surface : 0.0;
+    const double pixels = static_cast<double>(_adjustedScreenSize.width()) * _adjustedScreenSize.height();
+
+    return std::max(1.0, pixels * std::ceil(meanRayLength / std::max(_stepSize, 1e-3f)));
+}
+
+const char* VolumeRenderer::getANNBackendName() const
+{
+    switch (_annBackend) {
+    case ANNBackend::Faiss:
+        return "Faiss IVF";
+    case ANNBackend::BruteForce:
+        return "Exact";
+    case ANNBackend::Codebook:
+        return "Codebook";
+    default:
+        return "HNSW";
+    }
+}
+
+#ifdef DVR_ANN_BENCHMARK
+// Builds every available backend on the same volume and compares build time, query throughput and recall (against the exact search).
+// The queries are interpolations between neighbouring voxels, which resembles the trilinear samples of the full data render modes.
+void VolumeRenderer::benchmarkANNBackends(const std::vector<float>& voxelData, uint32_t numVoxels, uint32_t dimensions)
+{
+    using Clock = std::chrono::steady_clock;
+    auto secondsSince = [](Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); };
+
+    constexpr int k = 9;
+    if (numVoxels <= k) {
+        qDebug() << "ANN benchmark skipped, the volume has fewer voxels than the" << k << "neighbours of a query";
+        return;
+    }
+
+    // The exact reference costs numQueries * numVoxels * dimensions operations, limit that to ~1e11 for huge volumes
+    const int64_t numQueries = std::clamp<int64_t>(static_cast<int64_t>(1e11 / (static_cast<double>(numVoxels) * dimensions)), 100, 10000);
+
+    std::vector<float> queries(numQueries * dimensions);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<uint32_t> voxelDistribution(0, numVoxels - 2);
+    std::uniform_real_distribution<float> weightDistribution(0.0f, 1.0f);
+    for (int64_t i = 0; i < numQueries; i++) {
+        size_t voxel = voxelDistribution(generator);
+        float weight = weightDistribution(generator);
+        for (uint32_t d = 0; d < dimensions; d++)
+            queries[i * dimensions + d] = (1.0f - weight) * voxelData[voxel * dimensions + d] + weight * voxelData[(voxel + 1) * dimensions + d];
+    }
+
+    auto logResult = [&](const char* name, double buildSeconds, double querySeconds, const std::vector<int64_t>& labels, const std::vector<int64_t>& exactLabels) {
+        int64_t found = 0;
+        for (int64_t i = 0; i < numQueries; i++)
+            for (int j = 0; j < k; j++)
+                found += std::count(exactLabels.begin() + i * k, exactLabels.begin() + (i + 1) * k, labels[i * k + j]);
+
+        qDebug().nospace() << "ANN benchmark " << name << ": build " << buildSeconds << " s, "
+            << static_cast<int64_t>(numQueries / std::max(querySeconds, 1e-9)) << " queries/s, recall@" << k << " " << static_cast<double>(found) / (numQueries * k);
+    };
+
+    qDebug() << "ANN benchmark:" << numVoxels << "voxels," << dimensions << "channels," << numQueries << "queries";
+
+    // Exact search, also the reference for the recall of the other backends
+    std::vector<float> exactDistances(numQueries * k);
+    std::vector<int64_t> exactLabels(numQueries * k);
+    {
+        BruteForceKnn bruteForce;
+        auto start = Clock::now();
+        bruteForce.build(voxelData.data(), numVoxels, dimensions);
+        double buildSeconds = secondsSince(start);
+
+        start = Clock::now();
+        bruteForce.search(queries.data(), numQueries, dimensions, k, exactDistances.data(), exactLabels.data());
+        logResult(BruteForceKnn::getInstructionSet(), buildSeconds, secondsSince(start), exactLabels, exactLabels);
+    }
+
+    // Per query cost of the neighbour clustering, the generic ComputeMeanOfNN against the specialized computeMeanOfNN<K>
+    {
+        std::vector<float> positionData(static_cast<size_t>(numVoxels) * 2);
+        for (size_t i = 0; i < positionData.size(); i++)
+            positionData[i] = weightDistribution(generator);
+
+        float checksum = 0.0f; // Keeps the compiler from optimizing the loops away
+        auto start = Clock::now();
+        for (int64_t i = 0; i < numQueries; i++) {
+            std::vector<std::pair<float, int64_t>> neighbors;
+            for (int j = 0; j < k; j++)
+                neighbors.emplace_back(exactDistances[i * k + j], exactLabels[i * k + j]);
+            checksum += ComputeMeanOfNN(neighbors, k, positionData).x();
+        }
+        double genericSeconds = secondsSince(start);
+
+        start = Clock::now();
+        for (int64_t i = 0; i < numQueries; i++)
+            checksum -= computeMeanOfNN<k>(exactDistances.data() + i * k, exactLabels.data() + i * k, k, positionData).x();
+        double specializedSeconds = secondsSince(start);
+
+        qDebug().nospace() << "ANN benchmark mean of " << k << " neighbours: generic " << 1e9 * genericSeconds / numQueries << " ns/query, specialized "
+            << 1e9 * specializedSeconds / numQueries << " ns/query (difference " << checksum << ")";
+    }
+
+    {
+        hnswlib::L2Space space(dimensions);
+        auto start = Clock::now();
+        hnswlib::HierarchicalNSW<float> index(&space, numVoxels, _hnswM, _hnswEfConstruction);
+        #pragma omp parallel for schedule(dynamic, 1024)
+        for (int64_t i = 0; i < static_cast<int64_t>(numVoxels); ++i)
+            index.addPoint(voxelData.data() + i * dimensions, static_cast<hnswlib::labeltype>(i));
+        index.setEf(_hwnsEfSearch);
+        double buildSeconds = secondsSince(start);
+
+        std::vector<int64_t> labels(numQueries * k, -1);
+        start = Clock::now();
+        #pragma omp parallel for schedule(guided)
+        for (int64_t i = 0; i < numQueries; i++) {
+            auto resultQueue = index.searchKnn(queries.data() + i * dimensions, k);
+            for (int j = static_cast<int>(resultQueue.size()) - 1; j >= 0; j--) {
+                labels[i * k + j] = static_cast<int64_t>(resultQueue.top().second);
+                resultQueue.pop();
+            }
+        }
+        logResult("HNSW", buildSeconds, secondsSince(start), labels, exactLabels);
+        qDebug() << "ANN benchmark HNSW index memory:" << index.indexFileSize() / (1024 * 1024) << "MB";
+    }
+
+    // int8 scalar quantized HNSW, without and with re-ranking on the original vectors
+    {
+        ScalarQuantizedL2Space space(voxelData.data(), numVoxels, dimensions);
+        auto start = Clock::now();
+        hnswlib::HierarchicalNSW<float> index(&space, numVoxels, _hnswM, _hnswEfConstruction);
+        #pragma omp parallel
+        {
+            std::vector<uint8_t> codes(dimensions);
+            #pragma omp for schedule(dynamic, 1024)
+            for (int64_t i = 0; i < static_cast<int64_t>(numVoxels); ++i) {
+                space.quantize(voxelData.data() + i * dimensions, codes.data());
+                index.addPoint(codes.data(), static_cast<hnswlib::labeltype>(i));
+            }
+        }
+        index.setEf(_hwnsEfSearch);
+        double buildSeconds = secondsSince(start);
+        qDebug() << "ANN benchmark HNSW int8 index memory:" << index.indexFileSize() / (1024 * 1024) << "MB";
+
+        for (int rerankFactor : { 1, std::max(_quantizedRerankFactor, 2) }) {
+            std::vector<int64_t> labels(numQueries * k, -1);
+            start = Clock::now();
+            #pragma omp parallel
+            {
+                std::vector<uint8_t> codes(dimensions);
+                #pragma omp for schedule(guided)
+                for (int64_t i = 0; i < numQueries; i++) {
+                    const float* query = queries.data() + i * dimensions;
+                    space.quantize(query, codes.data());
+                    auto resultQueue = index.searchKnn(codes.data(), k * rerankFactor);
+
+                    std::vector<std::pair<float, int64_t>> answers;
+                    while (!resultQueue.empty()) {
+                        int64_t label = static_cast<int64_t>(resultQueue.top().second);
+                        float distance = resultQueue.top().first;
+                        if (rerankFactor > 1) {
+                            distance = 0.0f;
+                            for (uint32_t d = 0; d < dimensions; d++)
+                                distance += (voxelData[label * dimensions + d] - query[d]) * (voxelData[label * dimensions + d] - query[d]);
+                        }
+                        answers.emplace_back(distance, label);
+                        resultQueue.pop();
+                    }
+                    std::sort(answers.begin(), answers.end());
+                    for (int j = 0; j < std::min<int>(k, static_cast<int>(answers.size())); j++)
+                        labels[i * k + j] = answers[j].second;
+                }
+            }
+            logResult(rerankFactor > 1 ? "HNSW int8 + re-ranking" : "HNSW int8", buildSeconds, secondsSince(start), labels, exactLabels);
         }
+    }
+
+#ifdef USE_FAISS
+    {
+        int nlist = std::clamp(static_cast<int>(numVoxels / 1000), 32, 4096);
+        auto start = Clock::now();
+        faiss::IndexFlatL2 quantizer(dimensions);
+        faiss::IndexIVFFlat index(&quantizer, dimensions, nlist, faiss::METRIC_L2);
+        index.train(numVoxels, voxelData.data());
+        index.add(numVoxels, voxelData.data());
+        double buildSeconds = secondsSince(start);
+
+        std::vector<float> distances(numQueries * k);
+        std::vector<faiss::idx_t> faissLabels(numQueries * k);
+        start = Clock::now();
+        index.search(numQueries, queries.data(), k, distances.data(), faissLabels.data());
+        double querySeconds = secondsSince(start);
+        logResult("Faiss IVF", buildSeconds, querySeconds, std::vector<int64_t>(faissLabels.begin(), faissLabels.end()), exactLabels);
+    }
+#endif // USE_FAISS
+}
+#endif // DVR_ANN_BENCHMARK
+
+// Stops a running background index construction and waits until the worker thread has finished
+void VolumeRenderer::cancelANNBuild()
+{
+    if (!_annBuildTask.valid())
+        return;
+
+    _annBuildCancelled = true;
+    _annBuildTask.wait();
+    _annBuildTask = {};
+}
+
+bool VolumeRenderer::isANNIndexBuilding() const
+{
+    return _annBuildTask.valid() && _annBuildTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+bool VolumeRenderer::isANNIndexReady() const
+{
+    return _ANNAlgorithmTrained.load(std::memory_order_acquire);
 }
 
 
@@ -822,15 +1440,47 @@ void VolumeRenderer::batchSearch(
     uint32_t dimensions,                    // Dimensionality of a single query
     int k,                                  // Number of nearest neighbors to retrieve
     bool useWeightedMean,                   // Use weighted mean for the query
-    std::vector<float>& meanPositionData   // Output: The mean position data for the queries
+    std::vector<float>& meanPositionData,   // Output: The mean position data for the queries
+    const std::vector<int>* rayStartIndices // Optional: start query of every ray, the queries of a ray are consecutive (as in _GPUBatchesStartIndex)
 ) {
+    if (!isANNIndexReady()) {
+        qCritical() << "The ANN index is not ready, the queries cannot be searched.";
+        return;
+    }
+
     if (queryData.size() % dimensions != 0) {
         qCritical() << "Query data size is not a multiple of dimensions.";
     }
 
     int64_t numQueries = static_cast<int64_t>(queryData.size() / dimensions);
+    auto searchStart = std::chrono::steady_clock::now();
+
+    // A volume with fewer voxels than k has fewer neighbours than requested, the backends would fill the missing ones with label -1
+    k = static_cast<int>(std::min<size_t>(k, positionData.size() / 2));
+    if (k <= 0) {
+        qCritical() << "There are no voxel positions to search the nearest neighbours in.";
+        return;
+    }
+
+    if (_annBackend == ANNBackend::Codebook) {
+        // CPU fallback of the GPU lookup, k does not apply as every sample maps to a single centroid
+        _codebook.mapSamples(queryData.data(), numQueries, _codebookPositions, meanPositionData.data());
+    }
+    else if (_annBackend == ANNBackend::BruteForce) {
+        std::vector<int64_t> labels(numQueries * k);
+        std::vector<float> distances(numQueries * k);
+        _bruteForceIndex.search(queryData.data(), numQueries, dimensions, k, distances.data(), labels.data());
+
+        #pragma omp parallel for schedule(static)
+        for (int64_t i = 0; i < numQueries; i++) {
+            QVector2D meanPos = meanOfNearestNeighbours(distances.data() + i * k, labels.data() + i * k, k, k, positionData);
+            meanPositionData[i * 2] = meanPos.x();
+            meanPositionData[i * 2 + 1] = meanPos.y();
+        }
+    }
+    else
 #ifdef USE_FAISS
-    if (_useFaissANN) {
+    if (_annBackend == ANNBackend::Faiss) {
         if (!_faissIndexIVF->is_trained) {
             qCritical() << "Faiss IVF index is not trained!";
             return;
@@ -843,13 +1493,10 @@ void VolumeRenderer::batchSearch(
         _faissIndexIVF->search(numQueries, queryData.data(), k, distances.data(), labels.data());
         qDebug() << "Faiss IVF search completed.";
 
+        #pragma omp parallel for schedule(static)
         for (int64_t i = 0; i < numQueries; i++) {
-            std::vector<std::pair<float, int64_t>> answers;
-            for (int j = 0; j < k; j++) {
-                answers.emplace_back(distances[i * k + j], labels[i * k + j]);
-            }
             // Compute the mean position of the nearest neighbors.
-            QVector2D meanPos = ComputeMeanOfNN(answers, k, positionData);
+            QVector2D meanPos = meanOfNearestNeighbours(distances.data() + i * k, labels.data() + i * k, k, k, positionData);
             // Store the mean position in the output vector.
             meanPositionData[i * 2] = meanPos.x();
             meanPositionData[i * 2 + 1] = meanPos.y();
@@ -863,54 +1510,294 @@ void VolumeRenderer::batchSearch(
             qCritical() << "HNSW index is not initialized.";
         }
 
-        #pragma omp parallel for schedule(guided)
-        for (int64_t i = 0; i < numQueries; i++) { // it is important to use int64_t here to avoid overflow crashes
-            // Find pointer to the start of the i-th query.
-            const float* query = queryData.data() + static_cast<int64_t>(i * dimensions);
-            std::priority_queue<std::pair<float, hnswlib::labeltype>> resultQueue = _hnswIndex->searchKnn(query, k);
-
-            // Convert the priority queue to a vector.
-            std::vector<std::pair<float, int64_t>> answers;
-            while (!resultQueue.empty()) {
-                answers.push_back({ resultQueue.top().first, static_cast<int64_t>(resultQueue.top().second) });
-                resultQueue.pop();
-            }
-            QVector2D meanPos = ComputeMeanOfNN(answers, k, positionData);
-            meanPositionData[i * 2] = meanPos.x();
-            meanPositionData[i * 2 + 1] = meanPos.y();
+        // With re-ranking the quantized index returns more candidates, which are then ordered by their distance to the original vectors
+        const bool rerank = _quantizedSpace && !_rerankVectors.empty();
+        const int searchK = rerank ? k * _quantizedRerankFactor : k;
+
+        // In the ray coherent mode a thread processes all samples of a ray in order, and every search starts from the neighbours of the previous sample
+        const bool rayCoherent = _useRayCoherentSearch && rayStartIndices && !rayStartIndices->empty();
+        const int64_t numWorkItems = rayCoherent ? static_cast<int64_t>(rayStartIndices->size()) : numQueries;
+        std::atomic<int64_t> coldDistanceComputations = 0, warmDistanceComputations = 0;
+        std::atomic<int64_t> coldQueries = 0, warmQueries = 0;
 
+        #pragma omp parallel
+        {
+            std::vector<uint8_t> codes(_quantizedSpace ? dimensions : 0);
+            std::vector<std::pair<float, int64_t>> answers;     // Reused for every query of this thread
+            std::vector<float> neighbourDistances(searchK);
+            std::vector<int64_t> neighbourLabels(searchK);
+            std::vector<hnswlib::tableint> seeds;               // Neighbours of the previous sample on the ray
+
+            #pragma omp for schedule(guided)
+            for (int64_t item = 0; item < numWorkItems; item++) { // it is important to use int64_t here to avoid overflow crashes
+                const int64_t firstQuery = rayCoherent ? (*rayStartIndices)[item] : item;
+                const int64_t lastQuery = rayCoherent ? (item + 1 < numWorkItems ? (*rayStartIndices)[item + 1] : numQueries) : item + 1;
+                seeds.clear();
+
+                for (int64_t i = firstQuery; i < lastQuery; i++) {
+                    // Find pointer to the start of the i-th query.
+                    const float* query = queryData.data() + static_cast<int64_t>(i * dimensions);
+                    const void* searchQuery = query;
+                    if (_quantizedSpace) {
+                        _quantizedSpace->quantize(query, codes.data());
+                        searchQuery = codes.data();
+                    }
+
+                    answers.clear();
+                    if (rayCoherent) {
+                        bool coldStart = seeds.empty();
+                        size_t distanceComputations = 0;
+                        searchHNSWFromSeeds(searchQuery, seeds, searchK, answers, distanceComputations);
+                        (coldStart ? coldDistanceComputations : warmDistanceComputations) += distanceComputations;
+                        (coldStart ? coldQueries : warmQueries)++;
+                    }
+                    else {
+                        std::priority_queue<std::pair<float, hnswlib::labeltype>> resultQueue = _hnswIndex->searchKnn(searchQuery, searchK);
+
+                        // Convert the priority queue to a vector.
+                        while (!resultQueue.empty()) {
+                            answers.push_back({ resultQueue.top().first, static_cast<int64_t>(resultQueue.top().second) });
+                            resultQueue.pop();
+                        }
+                    }
+
+                    if (rerank) {
+                        for (auto& [distance, label] : answers) {
+                            const float* original = _rerankVectors.data() + label * dimensions;
+                            distance = 0.0f;
+                            for (uint32_t d = 0; d < dimensions; d++)
+                                distance += (original[d] - query[d]) * (original[d] - query[d]);
+                        }
+                        size_t keep = std::min<size_t>(k, answers.size());
+                        std::partial_sort(answers.begin(), answers.begin() + keep, answers.end());
+                        answers.resize(keep);
+                    }
+
+                    int count = static_cast<int>(answers.size());
+                    for (int j = 0; j < count; j++) {
+                        neighbourDistances[j] = answers[j].first;
+                        neighbourLabels[j] = answers[j].second;
+                    }
+                    QVector2D meanPos = meanOfNearestNeighbours(neighbourDistances.data(), neighbourLabels.data(), count, k, positionData);
+                    meanPositionData[i * 2] = meanPos.x();
+                    meanPositionData[i * 2 + 1] = meanPos.y();
+                }
+            }
         }
+
+        _fullDataSearchStats.coldQueries += coldQueries;
+        _fullDataSearchStats.warmQueries += warmQueries;
+        _fullDataSearchStats.coldDistanceComputations += coldDistanceComputations;
+        _fullDataSearchStats.warmDistanceComputations += warmDistanceComputations;
     }
+
+    _fullDataSearchStats.queries += numQueries;
+    _fullDataSearchStats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - searchStart).count();
 }
 
-// Extracts the frontfaces and backfaces texture data into a vector of floats
-void VolumeRenderer::getFacesTextureData(std::vector<float>& frontfacesData, std::vector<float>& backfacesData)
+// Logs the search totals of the full data render that just completed
+void VolumeRenderer::reportFullDataSearchStats() const
 {
-    _frontfacesTexture.bind();
-    // Read the frontfaces texture data (we request RGB – assuming alpha is not needed)
-    glBindTexture(GL_TEXTURE_2D, _frontfacesTexture.getHandle());
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, frontfacesData.data());
+    const FullDataSearchStats& stats = _fullDataSearchStats;
 
-    _backfacesTexture.bind();
-    // Read the backfaces texture data
-    glBindTexture(GL_TEXTURE_2D, _backfacesTexture.getHandle());
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, backfacesData.data());
+    if (stats.skipSamples > 0) {
+        qDebug() << "Voxel embedding skip:" << stats.skippedSamples << "of" << stats.skipSamples << "samples (" << 100.0 * stats.skippedSamples / stats.skipSamples
+            << "% ) skipped the kNN search at tolerance" << _voxelEmbeddingSkipTolerance;
+    }
 
-    // Unbind the textures
-    glBindTexture(GL_TEXTURE_2D, 0);
+    if (stats.queries == 0)
+        return;
+
+    qDebug() << getANNBackendName() << "search:" << stats.queries << "queries in" << stats.seconds << "s (" << static_cast<int64_t>(stats.queries / std::max(stats.seconds, 1e-6)) << "queries/s )";
+
+    if (stats.coldQueries + stats.warmQueries > 0) {
+        qDebug() << "Ray coherent search: visited nodes per query" << static_cast<double>(stats.coldDistanceComputations) / std::max<int64_t>(stats.coldQueries, 1) << "for cold starts ("
+            << stats.coldQueries << "queries)," << static_cast<double>(stats.warmDistanceComputations) / std::max<int64_t>(stats.warmQueries, 1) << "for warm starts (" << stats.warmQueries << "queries)";
+    }
 }
 
-// This function is used to get the GPU data in full data mode.
-// It uses the frontfaces and backfaces texture data to compute the ray lengths and sample counts for each pixel.
-// It then uses this data to create batches of pixels that can be processed in the GPU.
-void VolumeRenderer::getGPUFullDataModeBatches(std::vector<float>& frontfacesData, std::vector<float>& backfacesData)
+// Runs the kNN search only for the samples that are not close to their nearest voxel, the other samples take the embedding position of that voxel.
+// @param skipPositions: Two floats per sample, as written by the sampling shader (negative when the sample needs a kNN search).
+// @param rayStartIndices: Start sample of every ray, the remaining samples of a ray stay consecutive such that the ray coherent search still applies.
+void VolumeRenderer::batchSearchWithVoxelSkip(const std::vector<float>& queryData, const std::vector<float>& skipPositions, std::vector<float>& positionData, uint32_t dimensions, int k, bool useWeightedMean, std::vector<float>& meanPositionData, const std::vector<int>& rayStartIndices)
 {
+    const int64_t numQueries = static_cast<int64_t>(queryData.size() / dimensions);
+    const int64_t numRays = static_cast<int64_t>(rayStartIndices.size());
+
+    // Count the samples per ray that need a search, the prefix sum gives the start of every ray in the compacted queries
+    std::vector<int> searchRayStart(numRays + 1, 0);
+    #pragma omp parallel for schedule(static)
+    for (int64_t ray = 0; ray < numRays; ray++) {
+        int64_t lastSample = ray + 1 < numRays ? rayStartIndices[ray + 1] : numQueries;
+        int count = 0;
+        for (int64_t sample = rayStartIndices[ray]; sample < lastSample; sample++)
+            count += skipPositions[sample * 2] < 0.0f;
+        searchRayStart[ray + 1] = count;
+    }
+    std::partial_sum(searchRayStart.begin(), searchRayStart.end(), searchRayStart.begin());
+    const int64_t numSearched = searchRayStart[numRays];
+
+    // Copy the positions of the skipped samples and gather the queries of the others
+    std::vector<float> searchQueries(static_cast<size_t>(numSearched) * dimensions);
+    std::vector<int64_t> searchSamples(numSearched);
+    #pragma omp parallel for schedule(static)
+    for (int64_t ray = 0; ray < numRays; ray++) {
+        int64_t lastSample = ray + 1 < numRays ? rayStartIndices[ray + 1] : numQueries;
+        int64_t searchIndex = searchRayStart[ray];
+        for (int64_t sample = rayStartIndices[ray]; sample < lastSample; sample++) {
+            if (skipPositions[sample * 2] < 0.0f) {
+                std::copy_n(queryData.data() + sample * dimensions, dimensions, searchQueries.data() + searchIndex * dimensions);
+                searchSamples[searchIndex++] = sample;
+            }
+            else {
+                meanPositionData[sample * 2] = skipPositions[sample * 2];
+                meanPositionData[sample * 2 + 1] = skipPositions[sample * 2 + 1];
+            }
+        }
+    }
 
-    _GPUBatches.clear();
-    _GPUBatchesStartIndex.clear();
-    _subsetsMemory.clear();
+    _fullDataSearchStats.skipSamples += numQueries;
+    _fullDataSearchStats.skippedSamples += numQueries - numSearched;
 
-    // Get the dimensions of the textures
+    if (numSearched == 0)
+        return;
+
+    std::vector<float> searchPositions(static_cast<size_t>(numSearched) * 2);
+    std::vector<int> searchRayStartIndices(searchRayStart.begin(), searchRayStart.end() - 1);
+    batchSearch(searchQueries, positionData, dimensions, k, useWeightedMean, searchPositions, &searchRayStartIndices);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < numSearched; i++) {
+        meanPositionData[searchSamples[i] * 2] = searchPositions[i * 2];
+        meanPositionData[searchSamples[i] * 2 + 1] = searchPositions[i * 2 + 1];
+    }
+}
+
+// Best-first search on the level 0 graph of the HNSW index that starts from the given seeds instead of the entry point of the index.
+// Without seeds it descends the upper levels from the entry point first, exactly like searchKnn does.
+// On return seeds holds the internal ids of all candidates that were kept, such that the next sample of the ray can start from them,
+// and answers holds the k nearest neighbours (labels and distances, descending distance like the searchKnn queue).
+void VolumeRenderer::searchHNSWFromSeeds(const void* query, std::vector<hnswlib::tableint>& seeds, int k, std::vector<std::pair<float, int64_t>>& answers, size_t& distanceComputations) const
+{
+    auto* index = _hnswIndex.get();
+    auto distanceTo = [index, query, &distanceComputations](hnswlib::tableint id) {
+        distanceComputations++;
+        return index->fstdistfunc_(query, index->getDataByInternalId(id), index->dist_func_param_);
+    };
+
+    if (seeds.empty()) {
+        hnswlib::tableint currentObject = index->enterpoint_node_;
+        float currentDistance = distanceTo(currentObject);
+        for (int level = index->maxlevel_; level > 0; level--) {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                hnswlib::linklistsizeint* links = index->get_linklist(currentObject, level);
+                int size = index->getListCount(links);
+                auto* neighbours = reinterpret_cast<hnswlib::tableint*>(links + 1);
+                for (int j = 0; j < size; j++) {
+                    float distance = distanceTo(neighbours[j]);
+                    if (distance < currentDistance) {
+                        currentDistance = distance;
+                        currentObject = neighbours[j];
+                        changed = true;
+                    }
+                }
+            }
+        }
+        seeds.push_back(currentObject);
+    }
+
+    const size_t ef = std::max<size_t>(_hwnsEfSearch, k);
+    hnswlib::VisitedList* visitedList = index->visited_list_pool_->getFreeVisitedList();
+    hnswlib::vl_type* visited = visitedList->mass;
+    hnswlib::vl_type visitedTag = visitedList->curV;
+
+    std::priority_queue<std::pair<float, hnswlib::tableint>> topCandidates;  // The best ef nodes found so far, furthest on top
+    std::priority_queue<std::pair<float, hnswlib::tableint>> candidateSet;   // Nodes to expand, closest on top (negated distances)
+
+    for (hnswlib::tableint seed : seeds) {
+        if (visited[seed] == visitedTag)
+            continue;
+        visited[seed] = visitedTag;
+
+        float distance = distanceTo(seed);
+        topCandidates.emplace(distance, seed);
+        candidateSet.emplace(-distance, seed);
+    }
+    while (topCandidates.size() > ef)
+        topCandidates.pop();
+    float lowerBound = topCandidates.top().first;
+
+    while (!candidateSet.empty()) {
+        auto current = candidateSet.top();
+        if (-current.first > lowerBound && topCandidates.size() == ef)
+            break;
+        candidateSet.pop();
+
+        hnswlib::linklistsizeint* links = index->get_linklist0(current.second);
+        int size = index->getListCount(links);
+        auto* neighbours = reinterpret_cast<hnswlib::tableint*>(links + 1);
+        for (int j = 0; j < size; j++) {
+            hnswlib::tableint candidate = neighbours[j];
+            if (visited[candidate] == visitedTag)
+                continue;
+            visited[candidate] = visitedTag;
+
+            float distance = distanceTo(candidate);
+            if (topCandidates.size() < ef || distance < lowerBound) {
+                candidateSet.emplace(-distance, candidate);
+                topCandidates.emplace(distance, candidate);
+                if (topCandidates.size() > ef)
+                    topCandidates.pop();
+                lowerBound = topCandidates.top().first;
+            }
+        }
+    }
+    index->visited_list_pool_->releaseVisitedList(visitedList);
+
+    seeds.clear();
+    while (!topCandidates.empty()) {
+        seeds.push_back(topCandidates.top().second);
+        if (topCandidates.size() <= static_cast<size_t>(k))
+            answers.push_back({ topCandidates.top().first, static_cast<int64_t>(index->getExternalLabel(topCandidates.top().second)) });
+        topCandidates.pop();
+    }
+}
+
+// Extracts the frontfaces and backfaces texture data into a vector of floats
+void VolumeRenderer::getFacesTextureData(std::vector<float>& frontfacesData, std::vector<float>& backfacesData)
+{
+    _frontfacesTexture.bind();
+    // Read the frontfaces texture data (we request RGB – assuming alpha is not needed)
+    glBindTexture(GL_TEXTURE_2D, _frontfacesTexture.getHandle());
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, frontfacesData.data());
+
+    _backfacesTexture.bind();
+    // Read the backfaces texture data
+    glBindTexture(GL_TEXTURE_2D, _backfacesTexture.getHandle());
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_FLOAT, backfacesData.data());
+
+    // Unbind the textures
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// This function is used to get the GPU data in full data mode.
+// It uses the frontfaces and backfaces texture data to compute the ray lengths and sample counts for each pixel.
+// It then uses this data to create batches of pixels that can be processed in the GPU.
+void VolumeRenderer::getGPUFullDataModeBatches(std::vector<float>& frontfacesData, std::vector<float>& backfacesData)
+{
+
+    _GPUBatches.clear();
+    _GPUBatchesStartIndex.clear();
+    _GPUBatchesRayKeys.clear();
+    _GPUBatchesRayComplete.clear();
+    _subsetsMemory.clear();
+    _cachedRayPixels.clear();
+    _cachedRayStartIndex.clear();
+    _cachedRayMeanPositions.clear();
+
+    // Get the dimensions of the textures
     int width = _adjustedScreenSize.width();
     int height = _adjustedScreenSize.height();
 
@@ -921,19 +1808,38 @@ void VolumeRenderer::getGPUFullDataModeBatches(std::vector<float>& frontfacesDat
         return;
     }
 
+    // Get the per-sample size in bytes; this is used to determine
+    // how much space each sample occupies in the output array.
+    int dimensions = _volumeDataset->getComponentsPerVoxel();
+    size_t sampleSizeBytes = dimensions * sizeof(float);
+
+    // Calculate available GPU memory for the batch transfer, ~100MB are reserved for other data.
+    // The budget is checked once here, without it every ray would be dropped (and reported) on its own.
+    const size_t reservedBytes = _fullDataMemorySize + _voxelEmbeddingMemorySize + 100000;
+    if (_fullGPUMemorySize <= reservedBytes) {
+        qCritical() << "The volume data (" << (_fullDataMemorySize + _voxelEmbeddingMemorySize) / (1024 * 1024) << "MB) leaves no GPU memory for the full data batches, increase the VRAM parameter or use another render mode.";
+        return;
+    }
+    size_t availableMemoryInBytes = std::min(_fullGPUMemorySize - reservedBytes, size_t(2 * 1024 * 1024) * 1024);
+    if (_useVoxelEmbeddingSkip)
+        availableMemoryInBytes = availableMemoryInBytes / (dimensions + 2) * dimensions; // Every sample also gets two floats in the skip positions buffer
+    const size_t availableSamples = availableMemoryInBytes / sampleSizeBytes;
+    if (availableSamples == 0) {
+        qCritical() << "Not a single sample of" << dimensions << "channels fits in the available GPU memory, the full data mode cannot be used.";
+        return;
+    }
+
     //Create small batches of pixels that are spread out over the whole image ---
 
-    int numBatches = 2048; // Number of batches to divide the data into. (Tune as needed.)
+    // The pixels are processed in interleaved groups such that the threads get an even share of the screen, the groups are regrouped into the final batches afterwards.
+    int numBatches = 2048; // Number of pixel groups. (Tune as needed.)
     std::vector<std::vector<int>> batches(numBatches); // Each element is a vector of pixel indices.
     // Instead of memory requirements (in bytes), we now record the number of samples per ray.
     std::vector<std::vector<int>> batchRaySampleAmount(numBatches);
-    // The total reserved memory for each batch, in bytes, computed from the number of samples.
-    std::vector<size_t> batchRayMemoryRequirments(numBatches, 0);
-
-    // Get the per-sample size in bytes; this is used to determine
-    // how much space each sample occupies in the output array.
-    int dimensions = _volumeDataset->getComponentsPerVoxel();
-    size_t sampleSizeBytes = dimensions * sizeof(float);
+    // The cache key of every ray that still has to be computed, and the rays that were found in the ray cache.
+    std::vector<std::vector<RayCacheKey>> batchRayKeys(numBatches);
+    std::vector<std::vector<bool>> batchRayComplete(numBatches); // False for the rays that are cut off by the early ray termination
+    std::vector<std::vector<std::pair<int, RayCacheEntry*>>> batchCachedRays(numBatches);
 
     mv::Vector3f volumeSize;
     if (_useCustomRenderSpace)
@@ -941,7 +1847,10 @@ void VolumeRenderer::getGPUFullDataModeBatches(std::vector<float>& frontfacesDat
     else
         volumeSize = _volumeSize;
 
-    size_t maxBatchMemory = 0;
+    // Per pixel sample limits of the opacity pre-pass (see estimateRaySampleLimits), empty when the early ray termination is disabled
+    const std::vector<int>& sampleLimits = _fullDataArena.sampleLimits;
+    const bool useSampleLimits = sampleLimits.size() == static_cast<size_t>(width) * height;
+
     // Process pixels in parallel, grouping them by batch index.
     #pragma omp parallel for
     for (int batchIndex = 0; batchIndex < numBatches; ++batchIndex)
@@ -972,86 +1881,249 @@ void VolumeRenderer::getGPUFullDataModeBatches(std::vector<float>& frontfacesDat
                 diff.y * diff.y +
                 diff.z * diff.z);
 
+            // Compute the number of samples along this ray, the samples behind the estimated point where the ray becomes opaque are left out.
+            int sampleCount = std::ceil(rayLength / _stepSize);
+            bool complete = true;
+            if (useSampleLimits && sampleLimits[idx] < sampleCount) {
+                sampleCount = sampleLimits[idx];
+                complete = false;
+            }
+
+            // Rays that were already computed in an earlier render are taken from the cache (the cache is only read here, so the lookup is thread safe)
+            // A cut off entry is only valid when it covers the samples this ray needs now, the transfer function may have changed since it was stored.
+            RayCacheKey rayKey = getRayCacheKey(absFront, absBack);
+            if (_useRayCache) {
+                if (auto cached = _rayCache.find(rayKey); cached != _rayCache.end()) {
+                    auto entry = std::find_if(cached->second.begin(), cached->second.end(), [idx](const RayCacheEntry& candidate) { return candidate.pixelIndex == idx; });
+                    if (entry != cached->second.end() && (entry->complete || entry->meanPositions.size() / 2 >= static_cast<size_t>(sampleCount))) {
+                        batchCachedRays[batchIndex].emplace_back(idx, &*entry);
+                        continue;
+                    }
+                }
+            }
+
             // Record the pixel index.
             batches[batchIndex].push_back(idx);
-
-            // Compute the number of samples along this ray.
-            int sampleCount = std::ceil(rayLength / _stepSize);
+            batchRayKeys[batchIndex].push_back(rayKey);
+            batchRayComplete[batchIndex].push_back(complete);
 
             batchRaySampleAmount[batchIndex].push_back(sampleCount);
-            // Update the batch total (in bytes) for partitioning.
-            batchRayMemoryRequirments[batchIndex] += sampleCount * sampleSizeBytes;
-            #pragma omp critical
-            {
-                // Update the maximum memory requirement for this batch.
-                if (batchRayMemoryRequirments[batchIndex] > maxBatchMemory)
-                    maxBatchMemory = batchRayMemoryRequirments[batchIndex];
-            }
         }
     }
 
-    // Combine as many of the small batches as can possibly fit in the indicated GPU memory ---
-
-    // Calculate available GPU memory for the batch transfer
-    size_t availableMemoryInBytes = std::min(size_t(_fullGPUMemorySize - _fullDataMemorySize - 100000), (size_t(2 * 1024 * 1024) * 1024)); // ~100MB reserved for other data
-    if (availableMemoryInBytes < 0 || availableMemoryInBytes < maxBatchMemory)
-        throw std::runtime_error("Not enough GPU memory available for the GPU-CPU batch transfer.");
+    // Gather the cached rays, they are rendered as one extra batch before the GPU batches ---
+    _rayCacheRender++;
+    size_t numRays = 0;
+    for (int batchIndex = 0; batchIndex < numBatches; ++batchIndex)
+    {
+        numRays += batches[batchIndex].size() + batchCachedRays[batchIndex].size();
+        for (auto& [pixelIndex, entry] : batchCachedRays[batchIndex])
+        {
+            _cachedRayPixels.push_back(pixelIndex);
+            _cachedRayStartIndex.push_back(static_cast<int>(_cachedRayMeanPositions.size() / 2));
+            _cachedRayMeanPositions.insert(_cachedRayMeanPositions.end(), entry->meanPositions.begin(), entry->meanPositions.end());
+            entry->lastUsedRender = _rayCacheRender;
+        }
+    }
+    if (_useRayCache)
+        qDebug() << "Ray cache:" << _cachedRayPixels.size() << "of" << numRays << "rays reused," << _rayCache.size() << "ray cells cached (" << _rayCacheBytes / (1024 * 1024) << "MB)";
+
+    // Partition the rays into batches that are balanced by their sample count and ordered by screen importance ---
+
+    // Flatten the groups into one list of rays, the groups are only a means to process the pixels in parallel
+    struct Ray {
+        int pixelIndex;
+        int sampleCount;
+        RayCacheKey key;
+        bool complete;
+        int64_t importance; // Squared distance to the centre of the screen, lower is more important
+    };
+    std::vector<Ray> rays;
+    rays.reserve(numRays - _cachedRayPixels.size());
+    size_t totalSamples = 0;
+    size_t droppedRays = 0;
+    int longestDroppedRay = 0;
+    const int64_t centreX = width / 2;
+    const int64_t centreY = height / 2;
+    for (int batchIndex = 0; batchIndex < numBatches; ++batchIndex)
+    {
+        for (size_t i = 0; i < batches[batchIndex].size(); i++)
+        {
+            int pixelIndex = batches[batchIndex][i];
+            int sampleCount = batchRaySampleAmount[batchIndex][i];
+            if (static_cast<size_t>(sampleCount) > availableSamples) {
+                droppedRays++;
+                longestDroppedRay = std::max(longestDroppedRay, sampleCount);
+                continue;
+            }
 
+            int64_t dx = pixelIndex % width - centreX;
+            int64_t dy = pixelIndex / width - centreY;
+            rays.push_back({ pixelIndex, sampleCount, batchRayKeys[batchIndex][i], batchRayComplete[batchIndex][i], dx * dx + dy * dy });
+            totalSamples += sampleCount;
+        }
+    }
+    if (droppedRays > 0)
+        qCritical() << droppedRays << "rays (up to" << longestDroppedRay << "samples) do not fit in the available GPU memory, they are left out. Increase the step size.";
+
+    // The centre of the screen is rendered first, so the progressive display converges where the user is most likely looking
+    std::sort(rays.begin(), rays.end(), [](const Ray& a, const Ray& b) {
+        return a.importance != b.importance ? a.importance < b.importance : a.pixelIndex < b.pixelIndex;
+    });
+    if (rays.empty())
+        return;
 
-    std::vector<std::vector<int>> selectedBatchIndicesSubsets;
-    std::vector<int> currentSubset;
-    size_t currentSubsetMemory = 0; // in bytes
-    for (int i = 0; i < numBatches; i++)
+    // Every batch gets (about) the same number of samples, such that every batch takes about the same time.
+    // A ray goes to the batch its first sample falls in, so a batch can exceed the target by less than one ray; when that no longer fits in memory an extra batch is used.
+    size_t numSubsets = std::max<size_t>(1, (totalSamples + availableSamples - 1) / std::max<size_t>(availableSamples, 1));
+    std::vector<size_t> subsetSamples;
+    while (true)
     {
-        // If adding the current batch would exceed our limit (and currentSubset isn't empty), start a new subset.
-        if (!currentSubset.empty() &&
-            currentSubsetMemory + batchRayMemoryRequirments[i] > availableMemoryInBytes)
+        const size_t targetSamples = (totalSamples + numSubsets - 1) / numSubsets;
+        subsetSamples.assign(numSubsets, 0);
+        size_t runningSamples = 0;
+        for (const Ray& ray : rays)
         {
-            selectedBatchIndicesSubsets.push_back(currentSubset);
-            _subsetsMemory.push_back(currentSubsetMemory);
-            qDebug() << "Subset" << selectedBatchIndicesSubsets.size() - 1 << "requires" << currentSubsetMemory / (1024 * 1024) << "MB of GPU memory.";
-            currentSubset.clear();
-            currentSubsetMemory = 0;
+            size_t subset = std::min(runningSamples / std::max<size_t>(targetSamples, 1), numSubsets - 1);
+            subsetSamples[subset] += ray.sampleCount;
+            runningSamples += ray.sampleCount;
         }
 
-        if (batchRayMemoryRequirments[i] == 0)
-            continue; // Skip empty batches
-
-        // Add the current batch index to the current subset.
-        currentSubset.push_back(i);
-        currentSubsetMemory += batchRayMemoryRequirments[i];
+        if (*std::max_element(subsetSamples.begin(), subsetSamples.end()) <= availableSamples)
+            break;
+        numSubsets++;
     }
-    // Add the last subset (the one that did not cross the memory boundary yet)
-    if (!currentSubset.empty())
+
+    // Build the GPU batch arrays, for each ray the start offset is the cumulative sum of the sample counts of the rays before it in the batch.
+
+    _GPUBatches.resize(numSubsets);
+    _GPUBatchesStartIndex.resize(numSubsets);
+    _GPUBatchesRayKeys.resize(numSubsets);
+    _GPUBatchesRayComplete.resize(numSubsets);
+    _subsetsMemory.resize(numSubsets);
+    const size_t targetSamples = (totalSamples + numSubsets - 1) / numSubsets;
+    size_t runningSamples = 0;
+    std::vector<int> runningOffset(numSubsets, 0);
+    for (const Ray& ray : rays)
     {
-        selectedBatchIndicesSubsets.push_back(currentSubset);
-        _subsetsMemory.push_back(currentSubsetMemory);
-        qDebug() << "Subset" << selectedBatchIndicesSubsets.size() - 1 << "requires" << currentSubsetMemory / (1024 * 1024) << "MB of GPU memory.";
+        size_t subset = std::min(runningSamples / std::max<size_t>(targetSamples, 1), numSubsets - 1);
+        _GPUBatches[subset].push_back(ray.pixelIndex);
+        _GPUBatchesRayKeys[subset].push_back(ray.key);
+        _GPUBatchesRayComplete[subset].push_back(ray.complete);
+        _GPUBatchesStartIndex[subset].push_back(runningOffset[subset]);
+        runningOffset[subset] += ray.sampleCount;
+        runningSamples += ray.sampleCount;
     }
 
-    // We now build the GPU batch arrays. For each subset, we combine the batch indices
-    // and compute, for each ray, the start offset based on the cumulative sum of its sample counts.
-    _GPUBatches.resize(selectedBatchIndicesSubsets.size());
-    _GPUBatchesStartIndex.resize(selectedBatchIndicesSubsets.size());
-    for (size_t subsetIndex = 0; subsetIndex < selectedBatchIndicesSubsets.size(); ++subsetIndex)
+    for (size_t subset = 0; subset < numSubsets; subset++)
     {
-        int runningOffset = 0;
-        for (int batchIdx : selectedBatchIndicesSubsets[subsetIndex])
-        {
-            // Append the pixel indices from the current batch.
-            _GPUBatches[subsetIndex].insert(_GPUBatches[subsetIndex].end(),
-                batches[batchIdx].begin(),
-                batches[batchIdx].end());
-            // For each ray (pixel) in the current batch, compute its start offset.
-            for (int sampleCount : batchRaySampleAmount[batchIdx])
-            {
-                _GPUBatchesStartIndex[subsetIndex].push_back(runningOffset);
-                runningOffset += sampleCount;
-            }
+        _subsetsMemory[subset] = subsetSamples[subset] * sampleSizeBytes;
+        qDebug() << "Subset" << subset << "has" << _GPUBatches[subset].size() << "rays and" << subsetSamples[subset] << "samples, it requires" << _subsetsMemory[subset] / (1024 * 1024) << "MB of GPU memory.";
+    }
+}
+
+// Quantizes the entry and exit point of a ray (in volume space) to the grid of the ray cache
+VolumeRenderer::RayCacheKey VolumeRenderer::getRayCacheKey(const mv::Vector3f& absFront, const mv::Vector3f& absBack) const
+{
+    float scale = 1.0f / _rayCacheQuantization;
+    return RayCacheKey{ {
+        static_cast<int32_t>(std::lround(absFront.x * scale)),
+        static_cast<int32_t>(std::lround(absFront.y * scale)),
+        static_cast<int32_t>(std::lround(absFront.z * scale)),
+        static_cast<int32_t>(std::lround(absBack.x * scale)),
+        static_cast<int32_t>(std::lround(absBack.y * scale)),
+        static_cast<int32_t>(std::lround(absBack.z * scale)) } };
+}
+
+// The cached results are only valid for the settings they were computed with, so the cache is cleared whenever one of these changes.
+// Changes of the data itself (volume, reduced positions, ANN index) clear the cache directly through invalidateRayCache.
+void VolumeRenderer::updateRayCacheSettings()
+{
+    mv::Vector3f volumeSize = _useCustomRenderSpace ? _renderSpace : _volumeSize;
+    int positionTextureSize = _renderMode == RenderMode::MaterialTransition_FULL ? _materialPositionDataset->getImageSize().width() : _tfDataset->getImageSize().width();
+
+    std::vector<float> settings = {
+        _stepSize,
+        volumeSize.x, volumeSize.y, volumeSize.z,
+        static_cast<float>(_adjustedScreenSize.width()), static_cast<float>(_adjustedScreenSize.height()), // The entries are stored per pixel index
+        _rayCacheQuantization,
+        static_cast<float>(_renderMode),
+        static_cast<float>(positionTextureSize),
+        static_cast<float>(_useShading), // Determines the number of neighbours
+        static_cast<float>(_annBackend),
+        static_cast<float>(_useQuantizedANN),
+        static_cast<float>(_hwnsEfSearch),
+        static_cast<float>(_codebookSize),
+        static_cast<float>(_useVoxelEmbeddingSkip),
+        _voxelEmbeddingSkipTolerance
+    };
+    for (std::uint32_t index : _compositeIndices)
+        settings.push_back(static_cast<float>(index));
+
+    if (settings != _rayCacheSettings) {
+        invalidateRayCache();
+        _rayCacheSettings = settings;
+    }
+}
+
+// Stores the results of every ray of a GPU batch in the ray cache
+void VolumeRenderer::storeBatchInRayCache(int batchIndex, const std::vector<float>& meanPositions)
+{
+    if (!_useRayCache || static_cast<size_t>(batchIndex) >= _GPUBatchesRayKeys.size())
+        return; // The cache was invalidated while this render was in progress
+
+    const std::vector<int>& startIndices = _GPUBatchesStartIndex[batchIndex];
+    const std::vector<RayCacheKey>& rayKeys = _GPUBatchesRayKeys[batchIndex];
+    size_t batchBytes = meanPositions.size() * sizeof(float);
+
+    // Make room by evicting the rays that are not part of the current render (e.g. the camera moved away from them)
+    if (_rayCacheBytes + batchBytes > _rayCacheMaxBytes) {
+        for (auto it = _rayCache.begin(); it != _rayCache.end();) {
+            auto& entries = it->second;
+            auto unused = std::partition(entries.begin(), entries.end(), [this](const RayCacheEntry& entry) { return entry.lastUsedRender == _rayCacheRender; });
+            for (auto entry = unused; entry != entries.end(); ++entry)
+                _rayCacheBytes -= entry->meanPositions.size() * sizeof(float);
+            entries.erase(unused, entries.end());
+
+            if (entries.empty())
+                it = _rayCache.erase(it);
+            else
+                ++it;
+        }
+        if (_rayCacheBytes + batchBytes > _rayCacheMaxBytes)
+            return; // The visible rays alone already fill the cache
+    }
+
+    for (size_t ray = 0; ray < rayKeys.size(); ray++) {
+        size_t start = static_cast<size_t>(startIndices[ray]) * 2;
+        size_t end = ray + 1 < startIndices.size() ? static_cast<size_t>(startIndices[ray + 1]) * 2 : meanPositions.size();
+
+        // An existing entry of the same pixel is a ray of an earlier render that could not be reused (e.g. it was cut off), it is replaced
+        const int pixelIndex = _GPUBatches[batchIndex][ray];
+        auto& entries = _rayCache[rayKeys[ray]];
+        auto entry = std::find_if(entries.begin(), entries.end(), [pixelIndex](const RayCacheEntry& candidate) { return candidate.pixelIndex == pixelIndex; });
+        if (entry == entries.end()) {
+            entry = entries.emplace(entries.end());
+            entry->pixelIndex = pixelIndex;
+        }
+        else {
+            _rayCacheBytes -= entry->meanPositions.size() * sizeof(float);
         }
+        entry->meanPositions.assign(meanPositions.begin() + start, meanPositions.begin() + end);
+        entry->lastUsedRender = _rayCacheRender;
+        entry->complete = _GPUBatchesRayComplete[batchIndex][ray];
+        _rayCacheBytes += (end - start) * sizeof(float);
     }
 }
 
+void VolumeRenderer::invalidateRayCache()
+{
+    _rayCache.clear();
+    _rayCacheBytes = 0;
+    _GPUBatchesRayKeys.clear(); // Results of a render that is still in progress are not stored anymore
+    _GPUBatchesRayComplete.clear();
+}
+
 // This function retrieves the full data from the GPU using compute shaders.
 // It uses given vectors to decide which rays to sample and how much memory to allocate for the output.
 // The output is stored in the _outputSSBO buffer, which is then mapped to a CPU-side vector.
@@ -1062,40 +2134,68 @@ void VolumeRenderer::getGPUFullDataModeBatches(std::vector<float>& frontfacesDat
 // @param GPUBatches: Vector of vectors containing the pixel indices for each batch.
 // @param GPUBatchesStartIndex: Vector of vectors containing the start indices in the write buffer for each ray in a batch.
 // @param deleteBuffers: If true, the buffers will be deleted after use.
-void VolumeRenderer::retrieveBatchFullData(std::vector<float>& cpuOutput, int batchIndex, bool deleteBuffers)
-{
-    //Create the buffers if needed
-    if (!_GPUFullDataModeBuffersInitialized) {
-        glGenBuffers(1, &_indicesSSBO);
-        glGenBuffers(1, &_startIndexSSBO);
-        glGenBuffers(1, &_outputDataSSBO);
-        _GPUFullDataModeBuffersInitialized = true;
-        qDebug() << "Created GPU buffers for full data mode";
-    }
-
-    // populate The buffers
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _indicesSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER,
-        _GPUBatches[batchIndex].size() * sizeof(int),    // total reserved bytes for output.
-        _GPUBatches[batchIndex].data(),                  // pointer to the data.
-        GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _indicesSSBO);
-
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _startIndexSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER,
-        _GPUBatchesStartIndex[batchIndex].size() * sizeof(int),
-        _GPUBatchesStartIndex[batchIndex].data(),
-        GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _startIndexSSBO);
+// @param readBack: If false, the samples are left in the output buffer of the arena (binding 2) for further processing on the GPU and cpuOutput is not touched.
+// @param skipPositions: If given (and readBack is set), receives two floats per sample: the embedding position of the nearest voxel, or -1 when the sample needs a kNN search.
+void VolumeRenderer::retrieveBatchFullData(std::vector<float>& cpuOutput, int batchIndex, bool deleteBuffers, bool readBack, std::vector<float>* skipPositions)
+{
+    // populate The buffers, the arena buffers are only reallocated when they are too small for this batch
+    uploadArenaBuffer(_fullDataArena.pixelIndicesSSBO, _GPUBatches[batchIndex].data(), _GPUBatches[batchIndex].size() * sizeof(int), 0);
+    uploadArenaBuffer(_fullDataArena.startIndicesSSBO, _GPUBatchesStartIndex[batchIndex].data(), _GPUBatchesStartIndex[batchIndex].size() * sizeof(int), 1);
 
     //The write buffers
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _outputDataSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER,
-        _subsetsMemory[batchIndex],
-        nullptr,
-        GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _outputDataSSBO);
+    reserveArenaBuffer(_fullDataArena.outputSSBO, _subsetsMemory[batchIndex]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _fullDataArena.outputSSBO.id);
+
+    const bool embeddingSkip = readBack && skipPositions;
+    const size_t numSamples = _subsetsMemory[batchIndex] / (_volumeDataset->getComponentsPerVoxel() * sizeof(float));
+    reserveArenaBuffer(_fullDataArena.skipPositionsSSBO, (embeddingSkip ? numSamples : 1) * 2 * sizeof(float));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _fullDataArena.skipPositionsSSBO.id);
+
+#ifdef DVR_SAMPLING_BENCHMARK
+    if (!_samplingBenchmarkDone)
+        benchmarkSamplingWorkGroups(batchIndex, embeddingSkip);
+#endif
+
+    qDebug() << "Initialized compute shader with write memory size" << _subsetsMemory[batchIndex] / (1024 * 1024) << "MB";
+    dispatchSampling(batchIndex, embeddingSkip);
+
+    if (!readBack) {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        if (deleteBuffers)
+            releaseFullDataArena();
+        return;
+    }
 
+    // Since the shader writes float values, we'll copy into a vector of floats.
+    size_t numFloats = _subsetsMemory[batchIndex] / sizeof(float);
+    cpuOutput.resize(numFloats);
+
+    // Ensure that all writes to SSBOs are finished.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    glFinish();
+
+    // Bind the output buffers for reading, use glGetBufferSubData to copy the data directly.
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _fullDataArena.outputSSBO.id);
+
+    // Use glGetBufferSubData to copy the data directly.
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _subsetsMemory[batchIndex], cpuOutput.data());
+
+    if (embeddingSkip) {
+        skipPositions->resize(numSamples * 2);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, _fullDataArena.skipPositionsSSBO.id);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, numSamples * 2 * sizeof(float), skipPositions->data());
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+
+    if (deleteBuffers)
+        releaseFullDataArena();
+}
+
+// Binds the sampling shader with the textures and uniforms of a batch and dispatches it, the buffers of the batch have to be bound already.
+// A work group samples _samplingRaysPerGroup rays.
+void VolumeRenderer::dispatchSampling(int batchIndex, bool embeddingSkip)
+{
     // Bind the program
     _fullDataSamplerComputeShader->bind();
     _backfacesTexture.bind(0);
@@ -1107,6 +2207,16 @@ void VolumeRenderer::retrieveBatchFullData(std::vector<float>& cpuOutput, int ba
     _volumeTexture.bind(2);
     _fullDataSamplerComputeShader->setUniformValue("volumeData", 2);
 
+    _voxelEmbeddingTexture.bind(3);
+    _fullDataSamplerComputeShader->setUniformValue("voxelEmbedding", 3);
+    _fullDataSamplerComputeShader->setUniformValue("useEmbeddingSkip", embeddingSkip);
+    _fullDataSamplerComputeShader->setUniformValue("skipTolerance", _voxelEmbeddingSkipTolerance);
+
+    // The batches were sized with the sample limits, so the shader has to stop at the same sample
+    _fullDataArena.sampleLimitTexture.bind(4);
+    _fullDataSamplerComputeShader->setUniformValue("sampleLimits", 4);
+    _fullDataSamplerComputeShader->setUniformValue("useSampleLimits", !_fullDataArena.sampleLimits.empty());
+
     mv::Vector3f volumeSize;
     mv::Vector3f invVolumeSize;
     if (_useCustomRenderSpace) {
@@ -1133,36 +2243,195 @@ void VolumeRenderer::retrieveBatchFullData(std::vector<float>& cpuOutput, int ba
     _fullDataSamplerComputeShader->setUniformValue("stepSize", _stepSize);
     _fullDataSamplerComputeShader->setUniformValue("numIndices", static_cast<int>(_GPUBatches[batchIndex].size()));
     _fullDataSamplerComputeShader->setUniformValue("bricksNeeded", bricksNeeded);
+    _fullDataSamplerComputeShader->setUniformValue("useVec4Stores", _volumeDataset->getComponentsPerVoxel() % 4 == 0);
 
-    qDebug() << "Initialized compute shader with write memory size" << _subsetsMemory[batchIndex] / (1024 * 1024) << "MB";
-    // Dispatch the compute shader, we launch one invocation per index;
-    glDispatchCompute(_GPUBatches[batchIndex].size(), 1, 1);
+    int numGroups = (static_cast<int>(_GPUBatches[batchIndex].size()) + _samplingRaysPerGroup - 1) / _samplingRaysPerGroup;
+    glDispatchCompute(numGroups, 1, 1);
+}
 
-    // Since the shader writes float values, we'll copy into a vector of floats.
-    size_t numFloats = _subsetsMemory[batchIndex] / sizeof(float);
-    cpuOutput.resize(numFloats);
+// Compiles the sampling shader for a work group shape, the shape is injected as defines after the version line
+QOpenGLShaderProgram* VolumeRenderer::loadSamplingShader(int raysPerGroup, int sampleThreads)
+{
+    QFile file(":shaders/FullDataSampling.comp");
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical() << "Failed to open the sampling compute shader";
+        return nullptr;
+    }
+    QByteArray source = file.readAll();
+    int versionEnd = source.indexOf('\n') + 1;
+    source.insert(versionEnd, QByteArray("#define RAYS_PER_GROUP ") + QByteArray::number(raysPerGroup) + "\n#define SAMPLE_THREADS " + QByteArray::number(sampleThreads) + "\n");
+
+    auto* program = new QOpenGLShaderProgram();
+    if (!program->addCacheableShaderFromSourceCode(QOpenGLShader::Compute, source) || !program->link()) {
+        qCritical() << "Failed to load compute shader:" << program->log();
+        delete program;
+        return nullptr;
+    }
+    return program;
+}
 
-    // Ensure that all writes to SSBOs are finished.
-    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-    glFinish();
+#ifdef DVR_SAMPLING_BENCHMARK
+// Times the sampling shader of a batch for several work group shapes with GPU timer queries and keeps the fastest one for the rest of the session
+void VolumeRenderer::benchmarkSamplingWorkGroups(int batchIndex, bool embeddingSkip)
+{
+    _samplingBenchmarkDone = true;
+
+    const std::array<std::pair<int, int>, 6> shapes = { { { 1, 32 }, { 2, 16 }, { 4, 16 }, { 8, 8 }, { 16, 4 }, { 2, 32 } } }; // (rays per group, threads per ray)
+    QOpenGLShaderProgram* defaultShader = _fullDataSamplerComputeShader;
+    const int defaultRaysPerGroup = _samplingRaysPerGroup;
+    const int defaultSampleThreads = _samplingThreadsPerRay;
+
+    GLuint query;
+    glGenQueries(1, &query);
+
+    double bestMilliseconds = std::numeric_limits<double>::max();
+    std::pair<int, int> bestShape = { defaultRaysPerGroup, defaultSampleThreads };
+    for (const auto& [raysPerGroup, sampleThreads] : shapes) {
+        QOpenGLShaderProgram* variant = loadSamplingShader(raysPerGroup, sampleThreads);
+        if (!variant)
+            continue;
+
+        _fullDataSamplerComputeShader = variant;
+        _samplingRaysPerGroup = raysPerGroup;
+        dispatchSampling(batchIndex, embeddingSkip); // Warm-up, the first dispatch of a program includes driver work
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        dispatchSampling(batchIndex, embeddingSkip);
+        glEndQuery(GL_TIME_ELAPSED);
+
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        double milliseconds = nanoseconds / 1e6;
+        qDebug().nospace() << "Sampling benchmark: " << raysPerGroup << " rays x " << sampleThreads << " threads per group, " << milliseconds << " ms for " << _GPUBatches[batchIndex].size() << " rays";
+
+        if (milliseconds < bestMilliseconds) {
+            bestMilliseconds = milliseconds;
+            bestShape = { raysPerGroup, sampleThreads };
+        }
+        delete variant;
+    }
+    glDeleteQueries(1, &query);
+
+    _fullDataSamplerComputeShader = defaultShader;
+    _samplingRaysPerGroup = defaultRaysPerGroup;
+    if (bestShape != std::make_pair(defaultRaysPerGroup, defaultSampleThreads)) {
+        if (QOpenGLShaderProgram* fastest = loadSamplingShader(bestShape.first, bestShape.second)) {
+            delete _fullDataSamplerComputeShader;
+            _fullDataSamplerComputeShader = fastest;
+            _samplingRaysPerGroup = bestShape.first;
+            _samplingThreadsPerRay = bestShape.second;
+        }
+    }
+    qDebug() << "Sampling benchmark: using" << _samplingRaysPerGroup << "rays x" << _samplingThreadsPerRay << "threads per group";
+}
+#endif // DVR_SAMPLING_BENCHMARK
 
-    // Bind the output buffers for reading, use glGetBufferSubData to copy the data directly.
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _outputDataSSBO);
+// Makes sure the arena buffer can hold the given number of bytes, it is only reallocated when it is too small
+void VolumeRenderer::reserveArenaBuffer(FullDataArena::Buffer& buffer, size_t bytes)
+{
+    if (buffer.id == 0)
+        glGenBuffers(1, &buffer.id);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.id);
+    if (bytes > buffer.capacity) {
+        glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW);
+        buffer.capacity = bytes;
+        qDebug() << "Full data arena buffer grown to" << bytes / (1024 * 1024) << "MB";
+    }
+}
 
-    // Use glGetBufferSubData to copy the data directly.
-    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, _subsetsMemory[batchIndex], cpuOutput.data());
+// Copies the data into the arena buffer (growing it if needed) and binds it to the given shader storage binding
+void VolumeRenderer::uploadArenaBuffer(FullDataArena::Buffer& buffer, const void* data, size_t bytes, GLuint binding)
+{
+    reserveArenaBuffer(buffer, bytes);
+    if (bytes > 0)
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, data);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.id);
+}
+
+// Frees the buffers and CPU storage of the full data modes, called when the full data render mode session ends
+void VolumeRenderer::releaseFullDataArena()
+{
+    for (FullDataArena::Buffer* buffer : { &_fullDataArena.pixelIndicesSSBO, &_fullDataArena.startIndicesSSBO, &_fullDataArena.outputSSBO,
+                                           &_fullDataArena.skipPositionsSSBO, &_fullDataArena.sampleMappingSSBO, &_fullDataArena.meanPositionsSSBO }) {
+        if (buffer->id != 0)
+            glDeleteBuffers(1, &buffer->id);
+        *buffer = FullDataArena::Buffer();
+    }
+
+    for (std::vector<float>* storage : { &_fullDataArena.cpuOutput, &_fullDataArena.skipPositions, &_fullDataArena.positionData, &_fullDataArena.meanPositions }) {
+        storage->clear();
+        storage->shrink_to_fit();
+    }
+    for (std::vector<int>* storage : { &_fullDataArena.mappingSampleStart, &_fullDataArena.sampleLimits }) {
+        storage->clear();
+        storage->shrink_to_fit();
+    }
+    qDebug() << "Released the full data arena";
+}
+
+// Computes the embedding positions of the codebook centroids for the current (normalized) position data and uploads the codebook for the GPU lookup
+void VolumeRenderer::uploadCodebook(const std::vector<float>& positionData)
+{
+    _codebook.computeCentroidPositions(positionData, _codebookPositions);
+
+    if (!useGPUCodebookLookup())
+        return;
+
+    if (_codebookCentroidsSSBO == 0) {
+        glGenBuffers(1, &_codebookCentroidsSSBO);
+        glGenBuffers(1, &_codebookPositionsSSBO);
+    }
+
+    const std::vector<float>& centroids = _codebook.getCentroids();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _codebookCentroidsSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, centroids.size() * sizeof(float), centroids.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, _codebookPositionsSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, _codebookPositions.size() * sizeof(float), _codebookPositions.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
 
+bool VolumeRenderer::useGPUCodebookLookup() const
+{
+    return _annBackend == ANNBackend::Codebook && _useGPUCodebookLookup && isANNIndexReady() && _codebook.getDimensions() <= _codebookLookupTileFloats;
+}
 
-    if (deleteBuffers)
-    {
-        // Delete the buffers after use
-        glDeleteBuffers(1, &_indicesSSBO);
-        glDeleteBuffers(1, &_startIndexSSBO);
-        glDeleteBuffers(1, &_outputDataSSBO);
-        _GPUFullDataModeBuffersInitialized = false;
-        qDebug() << "Deleted GPU buffers for full data mode";
+// Maps the samples in the output buffer of the arena to the positions of their nearest centroids with FullDataCodebookLookup.comp
+// @param numSamples: Number of samples in the output buffer.
+// @param sampleDim: Number of floats per sample.
+// @return The arena buffer with two floats per sample, the same layout as the meanPositions of the CPU path.
+GLuint VolumeRenderer::lookupCodebookOnGPU(size_t numSamples, uint32_t sampleDim)
+{
+    reserveArenaBuffer(_fullDataArena.meanPositionsSSBO, numSamples * 2 * sizeof(float));
+    GLuint meanPositionsBuffer = _fullDataArena.meanPositionsSSBO.id;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _fullDataArena.outputSSBO.id);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _codebookCentroidsSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, _codebookPositionsSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, meanPositionsBuffer);
+
+    _codebookLookupComputeShader->bind();
+    _codebookLookupComputeShader->setUniformValue("numSamples", static_cast<GLuint>(numSamples));
+    _codebookLookupComputeShader->setUniformValue("numCentroids", static_cast<GLuint>(_codebook.getNumCentroids()));
+    _codebookLookupComputeShader->setUniformValue("dimensions", static_cast<GLuint>(sampleDim));
+
+    // The number of work groups per dispatch is limited (65535 is the guaranteed minimum), so large batches take several dispatches
+    const size_t workGroupSize = 64;
+    const size_t samplesPerDispatch = 65535 * workGroupSize;
+    for (size_t sampleOffset = 0; sampleOffset < numSamples; sampleOffset += samplesPerDispatch) {
+        size_t dispatchSamples = std::min(samplesPerDispatch, numSamples - sampleOffset);
+        _codebookLookupComputeShader->setUniformValue("sampleOffset", static_cast<GLuint>(sampleOffset));
+        glDispatchCompute(static_cast<GLuint>((dispatchSamples + workGroupSize - 1) / workGroupSize), 1, 1);
     }
+    _codebookLookupComputeShader->release();
+
+    // The composite shaders read the positions as shader storage
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    qDebug() << "Mapped" << numSamples << "samples to the codebook on the GPU.";
+
+    return meanPositionsBuffer;
 }
 
 // TODO : This function should be moved to a more appropriate location, as it is not specific to the VolumeRenderer class.
@@ -1190,59 +2459,52 @@ QVector2D computeWeightedMean(const std::vector<QVector2D>& points,
 }
 
 // This function renders the full data to the screen using the composite shader.
-// It takes the GPU batches and their start indices, as well as the mean positions of the samples.
+// It takes the pixels of a batch (a GPU batch or the rays found in the ray cache) and their start indices, as well as the mean positions of the samples.
 // The function also takes and updates the composite texture of the previous results as input, such that all previous batches are also rendered to the screen.
-void VolumeRenderer::renderBatchToScreen(int batchIndex, uint32_t sampleDim, std::vector<float>& meanPositions)
+void VolumeRenderer::renderBatchToScreen(const std::vector<int>& pixelIndices, const std::vector<int>& rayStartIndices, uint32_t sampleDim, std::vector<float>& meanPositions)
+{
+    uploadArenaBuffer(_fullDataArena.meanPositionsSSBO, meanPositions.data(), meanPositions.size() * sizeof(float), 2);
+
+    compositeBatchToScreen(pixelIndices, rayStartIndices, meanPositions.size() / 2, _fullDataArena.meanPositionsSSBO.id); // The meanPosition vector contains two floats per sample
+}
+
+// Composites a batch over the previous composite, with the mean positions of its samples already in a GPU buffer (two floats per sample).
+void VolumeRenderer::compositeBatchToScreen(const std::vector<int>& pixelIndices, const std::vector<int>& rayStartIndices, size_t numSamples, GLuint meanPositionsBuffer)
 {
     int width = _adjustedScreenSize.width();
     int height = _adjustedScreenSize.height();
 
-    std::vector<int> mappingSampleStart(_GPUBatchesStartIndex[batchIndex].size() + 1); // Start index for each ray as if each sample takes one space (we multiply by 2 in the shader)
-    for (size_t i = 0; i < mappingSampleStart.size(); i++) {
-        mappingSampleStart[i] = (_GPUBatchesStartIndex[batchIndex][i]); // The GPU start index has all components for each sample, so we need to divide by the number of components to get the samplePos
+    std::vector<int>& mappingSampleStart = _fullDataArena.mappingSampleStart; // Start index for each ray as if each sample takes one space (we multiply by 2 in the shader)
+    mappingSampleStart.assign(rayStartIndices.begin(), rayStartIndices.end());
+    mappingSampleStart.push_back(static_cast<int>(numSamples)); // The sentinel gives the sample amount of the last ray
+    int numRays = rayStartIndices.size();
+
+    // The ray ID texture is cleared to -1 and the ray IDs are scattered into it on the GPU, instead of uploading a screen sized array for every batch
+    mv::Texture2D& rayIDTexture = _fullDataArena.rayIDTexture;
+    const GLint noRay[4] = { -1, -1, -1, -1 };
+    _fullDataArena.rayIDFramebuffer.bind();
+    glClearBufferiv(GL_COLOR, 0, noRay);
+    _fullDataArena.rayIDFramebuffer.release();
+
+    if (numRays > 0) {
+        uploadArenaBuffer(_fullDataArena.pixelIndicesSSBO, pixelIndices.data(), pixelIndices.size() * sizeof(int), 0);
+        glBindImageTexture(0, rayIDTexture.getHandle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32I);
+
+        _rayIDScatterComputeShader->bind();
+        _rayIDScatterComputeShader->setUniformValue("numRays", numRays);
+        _rayIDScatterComputeShader->setUniformValue("width", width);
+        glDispatchCompute((numRays + 255) / 256, 1, 1);
+        _rayIDScatterComputeShader->release();
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
     }
-    mappingSampleStart[mappingSampleStart.size() - 1] = meanPositions.size() / 2; //Since the mappingSampleStart array keeps the indices for the sample amount and the meanPosition vector contains two floats per sample
-    int numRays = _GPUBatchesStartIndex[batchIndex].size();
 
-    std::vector<int> rayIDTextureData(_adjustedScreenSize.width() * _adjustedScreenSize.height(), -1);
-    int rayID = 0;
-    for (int i = 0; i < _GPUBatches[batchIndex].size(); i++) {
-        int pixelIndex = _GPUBatches[batchIndex][i];
-        rayIDTextureData[pixelIndex] = rayID;
-        rayID++;
-    }
-    qDebug() << "shader vectors created.";
-    mv::Texture2D rayIDTexture;
-    rayIDTexture.create();
-    rayIDTexture.bind();
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, _adjustedScreenSize.width(), _adjustedScreenSize.height(), 0, GL_RED_INTEGER, GL_INT, rayIDTextureData.data());
-    rayIDTexture.release();
-
-    GLuint sampleMappingBuffer;
-    glGenBuffers(1, &sampleMappingBuffer);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, sampleMappingBuffer);
-    glBufferData(GL_SHADER_STORAGE_BUFFER,
-        mappingSampleStart.size() * sizeof(int),
-        mappingSampleStart.data(),
-        GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, sampleMappingBuffer);
-
-    GLuint meanPositionsBuffer;
-    glGenBuffers(1, &meanPositionsBuffer);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meanPositionsBuffer);
-    glBufferData(GL_SHADER_STORAGE_BUFFER,
-        meanPositions.size() * sizeof(float),
-        meanPositions.data(),
-        GL_DYNAMIC_DRAW);
+    uploadArenaBuffer(_fullDataArena.sampleMappingSSBO, mappingSampleStart.data(), mappingSampleStart.size() * sizeof(int), 1);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, meanPositionsBuffer);
 
     // Swap over to a different framebuffer that we can use to write the results to a texture instead of the screen.
+    // The composite texture is attached before anything is cleared, it holds the results of the previous batches (it is cleared once per render in updateRenderModeParameters).
     _framebuffer.bind();
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     _framebuffer.setTexture(GL_COLOR_ATTACHMENT0, _prevFullCompositeTexture);
     //_framebuffer.setTexture(GL_DEPTH_ATTACHMENT, _depthTexture);
 
@@ -1259,9 +2521,7 @@ void VolumeRenderer::renderBatchToScreen(int batchIndex, uint32_t sampleDim, std
         _tfTexture.bind(1);
         _fullDataCompositeShader.uniform1i("tfTexture", 1);
 
-        _fullDataCompositeShader.uniform2f("invFaceTexSize", 1.0f / float(width), 1.0f / float(height));
         _fullDataCompositeShader.uniform2f("invTfTexSize", 1.0f / _tfDataset->getImageSize().width(), 1.0f / _tfDataset->getImageSize().height());
-        _fullDataCompositeShader.uniform1f("stepSize", _stepSize);
         _fullDataCompositeShader.uniform1i("useClutterRemover", _useClutterRemover);
 
         // Render a full-screen quad to composite the current batch's results over prevFullCompositeTexture.
@@ -1291,11 +2551,9 @@ void VolumeRenderer::renderBatchToScreen(int batchIndex, uint32_t sampleDim, std
         _fullDataMaterialTransitionShader.uniform1i("backFaces", 5);
 
         // Set required uniforms
-        _fullDataMaterialTransitionShader.uniform2f("invFaceTexSize", 1.0f / float(width), 1.0f / float(height));
         _fullDataMaterialTransitionShader.uniform2f("invTfTexSize", 1.0f / _materialPositionDataset->getImageSize().width(), 1.0f / _materialPositionDataset->getImageSize().height());
         _fullDataMaterialTransitionShader.uniform2f("invMatTexSize", 1.0f / _materialTransitionDataset->getImageSize().width(), 1.0f / _materialTransitionDataset->getImageSize().height());
         _fullDataMaterialTransitionShader.uniform1i("numRays", numRays);
-        _fullDataMaterialTransitionShader.uniform1f("stepSize", _stepSize);
         _fullDataMaterialTransitionShader.uniform3f("dataDimensions", _volumeSize.x, _volumeSize.y, _volumeSize.z);
 
         // Render a full-screen quad to composite the current batch's results over prevFullCompositeTexture.
@@ -1311,10 +2569,6 @@ void VolumeRenderer::renderBatchToScreen(int batchIndex, uint32_t sampleDim, std
 
     qDebug() << "Composite full data rendered into composite texture.";
 
-    // Clean up temporary GPU buffers.
-    glDeleteBuffers(1, &sampleMappingBuffer);
-    glDeleteBuffers(1, &meanPositionsBuffer);
-
     // Finally, render the updated composite texture to the screen(the default framebuffer).
     glBindFramebuffer(GL_FRAMEBUFFER, _defaultFramebuffer);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -1443,6 +2697,172 @@ QVector2D VolumeRenderer::ComputeMeanOfNN(const std::vector<std::pair<float, int
     return meanPos;
 }
 
+// Allocation free version of ComputeMeanOfNN for a compile time number of neighbours K, it computes the same mean with stack arrays and a flat union-find.
+// The neighbours are given as two arrays of (at most K) entries, count is the number of valid entries.
+template<int K>
+QVector2D VolumeRenderer::computeMeanOfNN(const float* distances, const int64_t* labels, int count, const std::vector<float>& positionData) const
+{
+    const int n = std::min(count, K);
+    if (n <= 0)
+        return QVector2D(0.0f, 0.0f);
+
+    if constexpr (K == 1) {
+        // A single neighbour is its own (largest) cluster and its weight cancels out, so no clustering or weighting is needed
+        return QVector2D(positionData[labels[0] * 2], positionData[labels[0] * 2 + 1]);
+    }
+    else {
+        constexpr float epsilon = 1.0f;        // To avoid division by zero and limit the impact of very close neighbours.
+        constexpr float clusterSlack = 0.1f;   // Slack for cluster thresholding, can be adjusted based on the dataset.
+
+        std::array<float, K> weights;
+        std::array<float, K> positionsX;
+        std::array<float, K> positionsY;
+        std::array<bool, K> chosen;
+        for (int i = 0; i < n; i++) {
+            weights[i] = 1.0f / (distances[i] + epsilon); // Inverse distance is used as weight
+            positionsX[i] = positionData[labels[i] * 2];
+            positionsY[i] = positionData[labels[i] * 2 + 1];
+            chosen[i] = true;
+        }
+
+        // Extract the largest cluster via MST + relative threshold, as in ComputeMeanOfNN
+        if (useLargestCluster && n > 1) {
+            std::array<float, K * K> distanceMatrix;
+            for (int a = 0; a < n; ++a) {
+                distanceMatrix[a * K + a] = 0.0f;
+                for (int b = a + 1; b < n; ++b) {
+                    float dx = positionsX[a] - positionsX[b];
+                    float dy = positionsY[a] - positionsY[b];
+                    float d = std::sqrt(dx * dx + dy * dy);
+                    distanceMatrix[a * K + b] = d;
+                    distanceMatrix[b * K + a] = d;
+                }
+            }
+
+            // Prim's MST, the edges are stored as (weight, u, v) in flat arrays
+            std::array<bool, K> inTree{};
+            std::array<float, K> minEdgeToTree;
+            std::array<int, K> mstParent;
+            std::array<float, K> edgeWeights;
+            std::array<int, K> edgeU;
+            std::array<int, K> edgeV;
+
+            inTree[0] = true;
+            for (int v = 1; v < n; ++v) {
+                minEdgeToTree[v] = distanceMatrix[v];
+                mstParent[v] = 0;
+            }
+
+            float minMstWeight = FLT_MAX;
+            int numEdges = 0;
+            for (int e = 0; e < n - 1; ++e) {
+                int bestV = -1;
+                float bestW = FLT_MAX;
+                for (int v = 1; v < n; ++v) {
+                    if (!inTree[v] && minEdgeToTree[v] < bestW) {
+                        bestW = minEdgeToTree[v];
+                        bestV = v;
+                    }
+                }
+                if (bestV < 0) // Only NaN distances are left
+                    break;
+
+                edgeWeights[e] = bestW;
+                edgeU[e] = mstParent[bestV];
+                edgeV[e] = bestV;
+                numEdges++;
+                minMstWeight = std::min(minMstWeight, bestW);
+                inTree[bestV] = true;
+
+                for (int v = 1; v < n; ++v) {
+                    float w = distanceMatrix[bestV * K + v];
+                    if (!inTree[v] && w < minEdgeToTree[v]) {
+                        minEdgeToTree[v] = w;
+                        mstParent[v] = bestV;
+                    }
+                }
+            }
+            float threshold = minMstWeight + clusterSlack;
+
+            // Flat union-find with path halving
+            std::array<int, K> root;
+            for (int v = 0; v < n; ++v)
+                root[v] = v;
+            auto findRoot = [&root](int x) {
+                while (root[x] != x) {
+                    root[x] = root[root[x]];
+                    x = root[x];
+                }
+                return x;
+            };
+
+            for (int e = 0; e < numEdges; ++e) {
+                if (edgeWeights[e] <= threshold)
+                    root[findRoot(edgeV[e])] = findRoot(edgeU[e]);
+            }
+
+            // Cluster sizes per root, on a tie the cluster of the first neighbour (in neighbour order) wins
+            std::array<int, K> clusterSize{};
+            for (int v = 0; v < n; ++v)
+                clusterSize[findRoot(v)]++;
+
+            int largestRoot = findRoot(0);
+            for (int v = 1; v < n; ++v) {
+                if (clusterSize[findRoot(v)] > clusterSize[largestRoot])
+                    largestRoot = findRoot(v);
+            }
+            for (int v = 0; v < n; ++v)
+                chosen[v] = findRoot(v) == largestRoot;
+        }
+
+        // Mean position (weighted or unweighted) of the chosen neighbours
+        float sumX = 0.0f;
+        float sumY = 0.0f;
+        float weightSum = 0.0f;
+        for (int i = 0; i < n; i++) {
+            if (!chosen[i])
+                continue;
+            float weight = useWeightedMean ? weights[i] : 1.0f;
+            sumX += positionsX[i] * weight;
+            sumY += positionsY[i] * weight;
+            weightSum += weight;
+        }
+        return QVector2D(sumX / weightSum, sumY / weightSum);
+    }
+}
+
+// Dispatches to the specialized computeMeanOfNN for the k values that are used, other values fall back on the generic ComputeMeanOfNN
+QVector2D VolumeRenderer::meanOfNearestNeighbours(const float* distances, const int64_t* labels, int count, int k, const std::vector<float>& positionData)
+{
+    // Missing neighbours (label -1, e.g. an IVF probe with too few points) are left out, they would index outside of the position data
+    const int64_t numPositions = static_cast<int64_t>(positionData.size() / 2);
+    if (std::any_of(labels, labels + count, [numPositions](int64_t label) { return label < 0 || label >= numPositions; })) {
+        std::vector<std::pair<float, int64_t>> neighbors;
+        for (int j = 0; j < count; j++) {
+            if (labels[j] >= 0 && labels[j] < numPositions)
+                neighbors.emplace_back(distances[j], labels[j]);
+        }
+        if (neighbors.empty())
+            return QVector2D(0.0f, 0.0f);
+        return ComputeMeanOfNN(neighbors, static_cast<int>(neighbors.size()), positionData);
+    }
+
+    switch (k) {
+    case 1:
+        return computeMeanOfNN<1>(distances, labels, count, positionData);
+    case 9:
+        return computeMeanOfNN<9>(distances, labels, count, positionData);
+    case 16:
+        return computeMeanOfNN<16>(distances, labels, count, positionData);
+    default:
+    {
+        std::vector<std::pair<float, int64_t>> neighbors;
+        for (int j = 0; j < count; j++)
+            neighbors.emplace_back(distances[j], labels[j]);
+        return ComputeMeanOfNN(neighbors, k, positionData);
+    }
+    }
+}
 
 
 void VolumeRenderer::updateRenderModeParameters()
@@ -1456,8 +2876,6 @@ void VolumeRenderer::updateRenderModeParameters()
     getFacesTextureData(frontfacesData, backfacesData);
     qDebug() << "Front and backfaces data retrieved.";
 
-    // Create the GPU full data batches. ---
-    getGPUFullDataModeBatches(frontfacesData, backfacesData);
     // Initialize the previous composite texture, this texture will hold the cumulative composite result.
     std::vector<float> emptyTextureData(screenWidth * screenHeight * 3, 0.0f);
 
@@ -1478,24 +2896,125 @@ void VolumeRenderer::updateRenderModeParameters()
         _tempNNMaterialVolume.release();
 
         // Load the material position dataset into the texture.
+        ensureMaterialPositionImage();
         loadNNVolumeToTexture(_tempNNMaterialVolume, _textureData, _materialPositionImage, _materialPositionDataset->getImageSize().width(), _volumeSize, _volumeDataset->getNumberOfVoxels(), true);
     }
+
+    // Retrieve the reduced 2D position data (e.g. from a dimension reduction dataset), it is the same for all batches of this render.
+    // The centroid and voxel embedding positions depend on it and on the position texture of the render mode, so they are updated for every render as well.
+    std::vector<float>& positionData = _fullDataArena.positionData;
+    positionData.resize(_volumeDataset->getNumberOfVoxels() * 2); // two floats per voxel.
+    _reducedPosDataset->populateDataForDimensions(positionData, std::vector<int>{0, 1});
+    normalizePositionData(positionData);
+
+    if (_annBackend == ANNBackend::Codebook)
+        uploadCodebook(positionData);
+    // The voxel embedding texture (8 bytes per voxel) only changes with the volume, the reduced positions and the size of the position texture they are normalized to
+    const int positionTextureSize = _renderMode == RenderMode::MaterialTransition_FULL ? _materialPositionDataset->getImageSize().width() : _tfDataset->getImageSize().width();
+    if ((_useVoxelEmbeddingSkip || _useEarlyRayTermination) && (_voxelEmbeddingStale || positionTextureSize != _voxelEmbeddingPositionTextureSize)) {
+        uploadVoxelEmbedding(positionData);
+        _voxelEmbeddingStale = false;
+        _voxelEmbeddingPositionTextureSize = positionTextureSize;
+    }
+
+    // Find where the rays become opaque before the batches are sized ---
+    estimateRaySampleLimits();
+
+    // Create the GPU full data batches, rays that are still in the ray cache are left out. ---
+    updateRayCacheSettings();
+    getGPUFullDataModeBatches(frontfacesData, backfacesData);
+}
+
+void VolumeRenderer::uploadVoxelEmbedding(const std::vector<float>& positionData)
+{
+    _voxelEmbeddingTexture.bind();
+    _voxelEmbeddingTexture.setData(_volumeSize.x, _volumeSize.y, _volumeSize.z, positionData, 2);
+    _voxelEmbeddingTexture.release();
+    _voxelEmbeddingMemorySize = positionData.size() * sizeof(float);
+}
+
+// Opacity pre-pass of the early ray termination: marches every ray through the voxel embedding positions and stores the number of samples
+// up to the point where the estimated opacity saturates, both in the sample limit texture (for the sampling shader) and on the CPU (for the batch sizes).
+void VolumeRenderer::estimateRaySampleLimits()
+{
+    std::vector<int>& sampleLimits = _fullDataArena.sampleLimits;
+    sampleLimits.clear();
+    if (!_useEarlyRayTermination)
+        return;
+
+    int width = _adjustedScreenSize.width();
+    int height = _adjustedScreenSize.height();
+    bool useMaterialTable = _renderMode == RenderMode::MaterialTransition_FULL;
+    const QSize tfSize = useMaterialTable ? _materialPositionDataset->getImageSize() : _tfDataset->getImageSize();
+
+    mv::Vector3f volumeSize = _useCustomRenderSpace ? _renderSpace : _volumeSize;
+
+    _opacityEstimateComputeShader->bind();
+    _frontfacesTexture.bind(0);
+    _opacityEstimateComputeShader->setUniformValue("frontFaces", 0);
+    _backfacesTexture.bind(1);
+    _opacityEstimateComputeShader->setUniformValue("backFaces", 1);
+    _voxelEmbeddingTexture.bind(2);
+    _opacityEstimateComputeShader->setUniformValue("voxelEmbedding", 2);
+    if (useMaterialTable) {
+        _materialPositionTexture.bind(3);
+        _materialTransitionTexture.bind(4);
+        _opacityEstimateComputeShader->setUniformValue("invMatTexSize", QVector2D(1.0f / _materialTransitionDataset->getImageSize().width(), 1.0f / _materialTransitionDataset->getImageSize().height()));
+    }
+    else {
+        _tfTexture.bind(3);
+        _tfTexture.bind(4); // Not read without the material table, but the sampler needs a valid texture
+        _opacityEstimateComputeShader->setUniformValue("invMatTexSize", QVector2D(1.0f, 1.0f));
+    }
+    _opacityEstimateComputeShader->setUniformValue("tfTexture", 3);
+    _opacityEstimateComputeShader->setUniformValue("materialTexture", 4);
+
+    _opacityEstimateComputeShader->setUniformValue("dataDimensions", QVector3D(volumeSize.x, volumeSize.y, volumeSize.z));
+    _opacityEstimateComputeShader->setUniformValue("invTfTexSize", QVector2D(1.0f / tfSize.width(), 1.0f / tfSize.height()));
+    _opacityEstimateComputeShader->setUniformValue("stepSize", _stepSize);
+    _opacityEstimateComputeShader->setUniformValue("useMaterialTable", useMaterialTable);
+    _opacityEstimateComputeShader->setUniformValue("terminationAlpha", _earlyTerminationAlpha);
+    _opacityEstimateComputeShader->setUniformValue("marginSamples", _earlyTerminationMarginSamples);
+
+    glBindImageTexture(0, _fullDataArena.sampleLimitTexture.getHandle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32I);
+    glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+    _opacityEstimateComputeShader->release();
+
+    // The limits are fetched as a texture by the sampling shader and read back here
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    sampleLimits.resize(static_cast<size_t>(width) * height);
+    _fullDataArena.sampleLimitTexture.bind();
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_INT, sampleLimits.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 void VolumeRenderer::renderFullData()
 {
     // Check available GPU memory for the batch transfer.
-    size_t availableMemoryInBytes = _fullGPUMemorySize - _fullDataMemorySize - 100000; // Reserve ~100MB for other data.
+    size_t availableMemoryInBytes = _fullGPUMemorySize - _fullDataMemorySize - _voxelEmbeddingMemorySize - 100000; // Reserve ~100MB for other data.
     if (availableMemoryInBytes < 0) {
         qCritical() << "Not enough GPU memory available for the GPU-CPU batch transfer.";
         return;
     }
 
     // Make sure the ANN (e.g. hnswlib) is prepared for the dataset.
-    if (!_ANNAlgorithmTrained) {
-        prepareANN();
-        _ANNAlgorithmTrained = true;
-        qDebug() << "ANN algorithm trained for full data mode.";
+    // The index is built on a worker thread, until it is ready the full data render modes have nothing to show.
+    if (!isANNIndexReady()) {
+        if (!_annBuildTask.valid()) {
+            // After a failed build nothing is retried until the data or the channels change
+            if (!_annBuildFailed) {
+                prepareANN();
+                qDebug() << "ANN index construction started for full data mode.";
+            }
+        }
+        else if (!isANNIndexBuilding()) {
+            // The build finished without publishing an index, this is reported once and the task is released for a later retry
+            _annBuildTask = {};
+            _annBuildFailed = true;
+            qCritical() << "The ANN index is not available, the full data render mode cannot be used.";
+        }
+        return;
     }
 
     // Initialize the GPU full data mode parameters if not already done.
@@ -1505,41 +3024,77 @@ void VolumeRenderer::renderFullData()
 
         updateRenderModeParameters();
         _fullDataModeBatch = 0;
-    }
-
-    std::vector<float> cpuOutput;
+        _fullDataSearchStats = {};
+
+        // The rays that were computed in earlier renders are composited right away
+        if (!_cachedRayPixels.empty()) {
+            renderBatchToScreen(_cachedRayPixels, _cachedRayStartIndex, _volumeDataset->getComponentsPerVoxel(), _cachedRayMeanPositions);
+            qDebug() << "Rendered" << _cachedRayPixels.size() << "cached rays to composite texture.";
+            _cachedRayPixels.clear();
+            _cachedRayStartIndex.clear();
+            _cachedRayMeanPositions.clear();
+        }
 
-    retrieveBatchFullData(cpuOutput, _fullDataModeBatch, true);
+        // Nothing left to compute, e.g. a re-render with unchanged camera and data
+        if (_GPUBatches.empty()) {
+            _fullDataModeBatch = -1;
+            _tempNNMaterialVolume.destroy();
 
-    // Retrieve the reduced 2D position data (e.g. from a dimension reduction dataset), they are needed for following computation ---
-    int pointAmount = _volumeDataset->getNumberOfVoxels() * 2; // two floats per voxel.
-    std::vector<float> positionData(pointAmount);
-    _reducedPosDataset->populateDataForDimensions(positionData, std::vector<int>{0, 1});
-    normalizePositionData(positionData);
+            glBindFramebuffer(GL_FRAMEBUFFER, _defaultFramebuffer);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderTexture(_prevFullCompositeTexture);
+            qDebug() << "Composite full rendering completed from the ray cache.";
+            return;
+        }
+    }
 
-    // Run approximate nearest-neighbour search on the retrieved CPU data.
     uint32_t sampleDim = _volumeDataset->getComponentsPerVoxel();
-    int64_t numQueries = static_cast<int64_t>(cpuOutput.size() / sampleDim);
-    std::vector<float> meanPositions(numQueries * 2);
 
-    int k = 1; // Number of nearest neighbours to consider for the mean position computation.
-    if (_useShading) { // I just use the same button since it is not used anyway
-        k = 9;
+    if (useGPUCodebookLookup()) {
+        // The samples stay on the GPU: they are sampled, mapped to the codebook and composited without a round trip to the CPU.
+        // Their positions are not read back either, so these rays are not stored in the ray cache.
+        retrieveBatchFullData(_fullDataArena.cpuOutput, _fullDataModeBatch, false, false);
+        size_t numSamples = _subsetsMemory[_fullDataModeBatch] / (sampleDim * sizeof(float));
+        GLuint meanPositionsBuffer = lookupCodebookOnGPU(numSamples, sampleDim);
+
+        compositeBatchToScreen(_GPUBatches[_fullDataModeBatch], _GPUBatchesStartIndex[_fullDataModeBatch], numSamples, meanPositionsBuffer);
     }
-    bool useWeightedMean = true;  // change to "true" if you need weighting.
-    batchSearch(cpuOutput, positionData, sampleDim, k, useWeightedMean, meanPositions);
+    else {
+        // The scratch storage of the arena keeps its capacity between batches, so the batches after the first one do not allocate
+        std::vector<float>& cpuOutput = _fullDataArena.cpuOutput;
+        std::vector<float>& skipPositions = _fullDataArena.skipPositions;
+        std::vector<float>& positionData = _fullDataArena.positionData; // Filled in updateRenderModeParameters
+
+        retrieveBatchFullData(cpuOutput, _fullDataModeBatch, false, true, _useVoxelEmbeddingSkip ? &skipPositions : nullptr);
 
-    cpuOutput.clear();  // Free memory immediately.
-    qDebug() << "Approximate lower dimensional positions estimated" << _fullDataModeBatch;
+        // Run approximate nearest-neighbour search on the retrieved CPU data.
+        int64_t numQueries = static_cast<int64_t>(cpuOutput.size() / sampleDim);
+        std::vector<float>& meanPositions = _fullDataArena.meanPositions;
+        meanPositions.resize(numQueries * 2);
 
-    // Composite this batch’s result over the previous composite and update the texture.
-    renderBatchToScreen( _fullDataModeBatch, sampleDim, meanPositions);
+        int k = 1; // Number of nearest neighbours to consider for the mean position computation.
+        if (_useShading) { // I just use the same button since it is not used anyway
+            k = 9;
+        }
+        bool useWeightedMean = true;  // change to "true" if you need weighting.
+        if (_useVoxelEmbeddingSkip)
+            batchSearchWithVoxelSkip(cpuOutput, skipPositions, positionData, sampleDim, k, useWeightedMean, meanPositions, _GPUBatchesStartIndex[_fullDataModeBatch]);
+        else
+            batchSearch(cpuOutput, positionData, sampleDim, k, useWeightedMean, meanPositions, &_GPUBatchesStartIndex[_fullDataModeBatch]);
+        storeBatchInRayCache(_fullDataModeBatch, meanPositions);
+
+        qDebug() << "Approximate lower dimensional positions estimated" << _fullDataModeBatch;
+
+        // Composite this batch’s result over the previous composite and update the texture.
+        renderBatchToScreen(_GPUBatches[_fullDataModeBatch], _GPUBatchesStartIndex[_fullDataModeBatch], sampleDim, meanPositions);
+    }
     qDebug() << "Rendered batch" << _fullDataModeBatch << "to composite texture.";
     if (_fullDataModeBatch == _GPUBatches.size() - 1) {
         _fullDataModeBatch = -1;
 
         // clean up the temporary texture used for the material volume.
         _tempNNMaterialVolume.destroy();
+        reportFullDataSearchStats();
         qDebug() << "Composite full rendering completed.";
     }
     else {
@@ -1570,22 +3125,6 @@ void VolumeRenderer::renderComposite2DPos()
     _tfTexture.bind(3);
     _2DCompositeShader.uniform1i("tfTexture", 3);
 
-    _2DCompositeShader.uniform1f("stepSize", _stepSize);
-
-    mv::Vector3f volumeSize;
-    mv::Vector3f invVolumeSize;
-    if (_useCustomRenderSpace) {
-        volumeSize = _renderSpace;
-        invVolumeSize = mv::Vector3f(1.0f / _renderSpace.x, 1.0f / _renderSpace.y, 1.0f / _renderSpace.z);
-    }
-    else {
-        volumeSize = _volumeSize;
-        invVolumeSize = mv::Vector3f(1.0f / _volumeSize.x, 1.0f / _volumeSize.y, 1.0f / _volumeSize.z);
-    }
-
-    _2DCompositeShader.uniform3fv("dimensions", 1, &volumeSize);
-    _2DCompositeShader.uniform3fv("invDimensions", 1, &invVolumeSize);
-    _2DCompositeShader.uniform2f("invFaceTexSize", 1.0f / _adjustedScreenSize.width(), 1.0f / _adjustedScreenSize.height());
     _2DCompositeShader.uniform2f("invTfTexSize", 1.0f / _tfDataset->getImageSize().width(), 1.0f / _tfDataset->getImageSize().height());
 
     drawDVRQuad(_2DCompositeShader);
@@ -1624,29 +3163,8 @@ void VolumeRenderer::renderCompositeColor()
     _volumeTexture.bind(2);
     _colorCompositeShader.uniform1i("volumeData", 2);
 
-    _colorCompositeShader.uniform1f("stepSize", _stepSize);
-
-    mv::Vector3f volumeSize;
-    mv::Vector3f invVolumeSize;
-    mv::Vector3f dimesnionVolumeRatio;
-    if (_useCustomRenderSpace) {
-        volumeSize = _renderSpace;
-        invVolumeSize = mv::Vector3f(1.0f / _renderSpace.x, 1.0f / _renderSpace.y, 1.0f / _renderSpace.z);
-        dimesnionVolumeRatio = mv::Vector3f(_renderSpace.x / _volumeSize.x, _renderSpace.y / _volumeSize.y, _renderSpace.z / _volumeSize.z);
-    }
-    else {
-        volumeSize = _volumeSize;
-        invVolumeSize = mv::Vector3f(1.0f / _volumeSize.x, 1.0f / _volumeSize.y, 1.0f / _volumeSize.z);
-        dimesnionVolumeRatio = mv::Vector3f(1.0f, 1.0f, 1.0f); // No custom render space, so ratio is 1:1
-    }
-
-    _colorCompositeShader.uniform3fv("dimensions", 1, &volumeSize);
-    _colorCompositeShader.uniform3fv("invDimensions", 1, &invVolumeSize);
-    _colorCompositeShader.uniform2f("invFaceTexSize", 1.0f / _adjustedScreenSize.width(), 1.0f / _adjustedScreenSize.height());
     _colorCompositeShader.uniform2f("invTfTexSize", 1.0f / _tfDataset->getImageSize().width(), 1.0f / _tfDataset->getImageSize().height());
 
-    //_colorCompositeShader.uniform3fv("dimensionVolumeRatio", 1, &dimesnionVolumeRatio);
-
     drawDVRQuad(_colorCompositeShader);
 
     _framebuffer.release();
@@ -1661,7 +3179,6 @@ void VolumeRenderer::renderCompositeColor()
     glDepthFunc(GL_LEQUAL);
 }
 
-
 // Render using a standard MIP algorithm on a 1D slice of the volume
 void VolumeRenderer::render1DMip()
 {
@@ -1683,25 +3200,9 @@ void VolumeRenderer::render1DMip()
     _volumeTexture.bind(2);
     _1DMipShader.uniform1i("volumeData", 2);
 
-    _1DMipShader.uniform1f("stepSize", _stepSize);
     _1DMipShader.uniform1f("volumeMaxValue", _scalarVolumeDataRange.second);
     _1DMipShader.uniform1i("chosenDim", _mipDimension);
 
-    mv::Vector3f volumeSize;
-    mv::Vector3f invVolumeSize;
-    if (_useCustomRenderSpace) {
-        volumeSize = _renderSpace;
-        invVolumeSize = mv::Vector3f(1.0f / _renderSpace.x, 1.0f / _renderSpace.y, 1.0f / _renderSpace.z);
-    }
-    else {
-        volumeSize = _volumeSize;
-        invVolumeSize = mv::Vector3f(1.0f / _volumeSize.x, 1.0f / _volumeSize.y, 1.0f / _volumeSize.z);
-    }
-
-    _1DMipShader.uniform3fv("dimensions", 1, &volumeSize);
-    _1DMipShader.uniform3fv("invDimensions", 1, &invVolumeSize);
-    _1DMipShader.uniform2f("invFaceTexSize", 1.0f / _adjustedScreenSize.width(), 1.0f / _adjustedScreenSize.height());
-
     drawDVRQuad(_1DMipShader);
 
     _framebuffer.release();
@@ -1742,27 +3243,9 @@ void VolumeRenderer::renderMaterialTransition2D()
     _materialTransitionTexture.bind(4);
     _materialTransition2DShader.uniform1i("materialTexture", 4);
 
-    _materialTransition2DShader.uniform1f("stepSize", _stepSize);
-
     _materialTransition2DShader.uniform1i("useShading", _useShading);
     _materialTransition2DShader.uniform1f("useClutterRemover", _useClutterRemover);
-    _materialTransition2DShader.uniform3fv("camPos", 1, &_cameraPos);
-    _materialTransition2DShader.uniform3fv("lightPos", 1, &_cameraPos);
 
-    mv::Vector3f volumeSize;
-    mv::Vector3f invVolumeSize;
-    if (_useCustomRenderSpace) {
-        volumeSize = _renderSpace;
-        invVolumeSize = mv::Vector3f(1.0f / _renderSpace.x, 1.0f / _renderSpace.y, 1.0f / _renderSpace.z);
-    }
-    else {
-        volumeSize = _volumeSize;
-        invVolumeSize = mv::Vector3f(1.0f / _volumeSize.x, 1.0f / _volumeSize.y, 1.0f / _volumeSize.z);
-    }
-
-    _materialTransition2DShader.uniform3fv("dimensions", 1, &volumeSize);
-    _materialTransition2DShader.uniform3fv("invDimensions", 1, &invVolumeSize);
-    _materialTransition2DShader.uniform2f("invFaceTexSize", 1.0f / _adjustedScreenSize.width(), 1.0f / _adjustedScreenSize.height());
     _materialTransition2DShader.uniform2f("invTfTexSize", 1.0f / _materialPositionDataset->getImageSize().width(), 1.0f / _materialPositionDataset->getImageSize().height());
     _materialTransition2DShader.uniform2f("invMatTexSize", 1.0f / _materialTransitionDataset->getImageSize().width(), 1.0f / _materialTransitionDataset->getImageSize().height());
 
@@ -1803,26 +3286,9 @@ void VolumeRenderer::renderNNMaterialTransition()
     _materialTransitionTexture.bind(3);
     _nnMaterialTransitionShader.uniform1i("materialTexture", 3);
 
-    _nnMaterialTransitionShader.uniform1f("stepSize", _stepSize);
     _nnMaterialTransitionShader.uniform1f("useClutterRemover", _useClutterRemover);
     _nnMaterialTransitionShader.uniform1i("useShading", _useShading);
-    _nnMaterialTransitionShader.uniform3fv("camPos", 1, &_cameraPos);
-    _nnMaterialTransitionShader.uniform3fv("lightPos", 1, &_cameraPos);
 
-    mv::Vector3f volumeSize;
-    mv::Vector3f invVolumeSize;
-    if (_useCustomRenderSpace) {
-        volumeSize = _renderSpace;
-        invVolumeSize = mv::Vector3f(1.0f / _renderSpace.x, 1.0f / _renderSpace.y, 1.0f / _renderSpace.z);
-    }
-    else {
-        volumeSize = _volumeSize;
-        invVolumeSize = mv::Vector3f(1.0f / _volumeSize.x, 1.0f / _volumeSize.y, 1.0f / _volumeSize.z);
-    }
-
-    _nnMaterialTransitionShader.uniform3fv("dimensions", 1, &volumeSize);
-    _nnMaterialTransitionShader.uniform3fv("invDimensions", 1, &invVolumeSize);
-    _nnMaterialTransitionShader.uniform2f("invFaceTexSize", 1.0f / _adjustedScreenSize.width(), 1.0f / _adjustedScreenSize.height());
     _nnMaterialTransitionShader.uniform2f("invMatTexSize", 1.0f / _materialTransitionDataset->getImageSize().width(), 1.0f / _materialTransitionDataset->getImageSize().height());
 
     drawDVRQuad(_nnMaterialTransitionShader);
@@ -1863,23 +3329,7 @@ void VolumeRenderer::renderAltNNMaterialTransition()
     _altNNMaterialTransitionShader.uniform1i("materialTexture", 3);
 
     _altNNMaterialTransitionShader.uniform1i("useShading", _useShading);
-    _altNNMaterialTransitionShader.uniform3fv("camPos", 1, &_cameraPos);
-    _altNNMaterialTransitionShader.uniform3fv("lightPos", 1, &_cameraPos);
-
-    mv::Vector3f volumeSize;
-    mv::Vector3f invVolumeSize;
-    if (_useCustomRenderSpace) {
-        volumeSize = _renderSpace;
-        invVolumeSize = mv::Vector3f(1.0f / _renderSpace.x, 1.0f / _renderSpace.y, 1.0f / _renderSpace.z);
-    }
-    else {
-        volumeSize = _volumeSize;
-        invVolumeSize = mv::Vector3f(1.0f / _volumeSize.x, 1.0f / _volumeSize.y, 1.0f / _volumeSize.z);
-    }
 
-    _altNNMaterialTransitionShader.uniform3fv("dimensions", 1, &volumeSize);
-    _altNNMaterialTransitionShader.uniform3fv("invDimensions", 1, &invVolumeSize);
-    _altNNMaterialTransitionShader.uniform2f("invFaceTexSize", 1.0f / _adjustedScreenSize.width(), 1.0f / _adjustedScreenSize.height());
     _altNNMaterialTransitionShader.uniform2f("invMatTexSize", 1.0f / _materialTransitionDataset->getImageSize().width(), 1.0f / _materialTransitionDataset->getImageSize().height());
 
     drawDVRQuad(_altNNMaterialTransitionShader);
@@ -1911,6 +3361,7 @@ void VolumeRenderer::render()
 {
     //These methods update the perquisites needed for any of the rendering methods
     updateMatrices();
+    updateFrameState();
     renderDirections();
 
     glBindFramebuffer(GL_FRAMEBUFFER, _defaultFramebuffer);
@@ -1922,6 +3373,10 @@ void VolumeRenderer::render()
             updataDataTexture();
             _dataSettingsChanged = false;
         }
+        if (!loadRenderModeShaders(_renderMode)) {
+            qCritical() << "The shaders of the render mode are not available";
+            return;
+        }
         if (_renderMode == RenderMode::MaterialTransition_FULL || _renderMode == RenderMode::MULTIDIMENSIONAL_COMPOSITE_FULL)
             renderFullData();
         else if (_renderMode == RenderMode::MaterialTransition_2D)
@@ -1956,10 +3411,24 @@ void VolumeRenderer::renderTexture(mv::Texture2D& texture)
 
 void VolumeRenderer::destroy()
 {
+    cancelANNBuild();
+    releaseFullDataArena();
+    glDeleteBuffers(1, &_codebookCentroidsSSBO);
+    glDeleteBuffers(1, &_codebookPositionsSSBO);
+    _codebookCentroidsSSBO = 0;
+    _codebookPositionsSSBO = 0;
+    for (QOpenGLShaderProgram** shader : { &_fullDataSamplerComputeShader, &_codebookLookupComputeShader, &_rayIDScatterComputeShader, &_opacityEstimateComputeShader }) {
+        delete *shader;
+        *shader = nullptr;
+    }
+    _fullDataComputeShadersLoaded = false;
+    _fullDataComputeShadersValid = false;
     _vao.destroy();
     _vboCube.destroy();
     _iboCube.destroy();
     _surfaceShader.destroy();
     _textureShader.destroy();
+    glDeleteBuffers(1, &_frameStateUBO);
+    _frameStateUBO = 0;
 }
 
@@ -16,10 +16,18 @@
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLShaderProgram>
 #include <vector>
+#include <array>
+#include <unordered_map>
+#include <atomic>
+#include <future>
 #include <VolumeDataPlugin/Volumes.h>
 #include <ImageData/Images.h>
 #include <PointData/PointData.h>
 #include "MCArrays.h"
+#include "BruteForceKnn.h"
+#include "ScalarQuantizedSpace.h"
+#include "KMeansCodebook.h"
+#include "CachedShaderProgram.h"
 
 #include <hnswlib/hnswlib.h>
 #ifdef USE_FAISS
@@ -75,6 +83,14 @@ enum RenderMode {
     MaterialTransition_FULL
 };
 
+// Nearest neighbour search backends of the full data render modes
+enum class ANNBackend {
+    HNSW,           // Approximate graph based search (hnswlib), for large volumes
+    Faiss,          // Approximate IVF search, only available when compiled with USE_FAISS
+    BruteForce,     // Exact blocked search, for volumes with few channels or moderate voxel counts
+    Codebook        // Nearest centroid of a k-means codebook, the lookup runs in a compute shader such that the samples never leave the GPU
+};
+
 class VolumeRenderer : protected QOpenGLFunctions_4_3_Core
 {
 public:
@@ -105,31 +121,160 @@ public:
 
     mv::Vector3f getVolumeSize() { return _volumeSize; }
     bool getFullRenderModeInProgress() { return _fullDataModeBatch != -1; }
+    bool isANNIndexBuilding() const; // True while the ANN index for the full data modes is constructed in the background
+    bool isANNIndexReady() const;    // True once the worker thread has published a finished index, only then the index members may be read
 
     void init();
     void resize(QSize renderSize);
+    bool warmUpNextShader(); // Links one shader program that no render mode has used yet, returns false when there is nothing left to warm up
+    bool isShaderWarmUpEnabled() const { return _useShaderWarmUp; }
 
     void setDefaultRenderSettings();
 
     void render();
     void destroy();
 
+private:
+    // Key of the cross-frame ray cache: the entry and exit point of a ray quantized in voxel space. A key holds one ray per pixel,
+    // so a pixel reuses its own ray of an earlier render as long as its entry and exit point stay in the same cells (e.g. a small rotation),
+    // while neighbouring pixels in the same cells never share a ray.
+    struct RayCacheKey {
+        std::array<int32_t, 6> coordinates;
+
+        bool operator==(const RayCacheKey& other) const { return coordinates == other.coordinates; }
+    };
+
+    struct RayCacheKeyHash {
+        size_t operator()(const RayCacheKey& key) const {
+            size_t hash = 0;
+            for (int32_t coordinate : key.coordinates)
+                hash = hash * 1000003u ^ static_cast<size_t>(static_cast<uint32_t>(coordinate));
+            return hash;
+        }
+    };
+
+    // CPU mirror of the std140 FrameState uniform block of the shaders, vec3 members take 16 bytes unless a float fills them up
+    struct FrameState {
+        float modelViewProjection[16];
+        float model[16];
+        float minClippingPlane[3];
+        float stepSize;
+        float maxClippingPlane[3];
+        float padding0;
+        float dimensions[3];
+        float padding1;
+        float invDimensions[3];
+        float padding2;
+        float renderCubeSize[3];
+        float padding3;
+        float camPos[3];
+        float padding4;
+        float lightPos[3];
+        float padding5;
+        float invFaceTexSize[2];
+        float padding6[2];
+    };
+    static_assert(sizeof(FrameState) == 256, "FrameState must match the std140 layout of the FrameState uniform block");
+
+    // Scratch buffers and textures of the full data modes. They live for the whole full data render mode session:
+    // the GPU buffers only grow, the ray ID texture follows the viewport and the CPU vectors keep their capacity between batches.
+    struct FullDataArena {
+        struct Buffer {
+            GLuint id = 0;
+            size_t capacity = 0;                // Allocated bytes
+        };
+
+        Buffer pixelIndicesSSBO;                // Pixel of every ray of the batch (binding 0 of the sampling and ray ID scatter shaders)
+        Buffer startIndicesSSBO;                // Start sample of every ray (binding 1 of the sampling shader)
+        Buffer outputSSBO;                      // The samples (binding 2 of the sampling shader)
+        Buffer skipPositionsSSBO;               // See _useVoxelEmbeddingSkip (binding 3 of the sampling shader)
+        Buffer sampleMappingSSBO;               // Start sample of every ray plus sentinel (binding 1 of the composite shaders)
+        Buffer meanPositionsSSBO;               // Position of every sample (binding 2 of the composite shaders)
+
+        mv::Texture2D rayIDTexture;             // Ray of every pixel of the current batch, -1 for the pixels outside the batch
+        mv::Framebuffer rayIDFramebuffer;       // Only used to clear the ray ID texture on the GPU
+        mv::Texture2D sampleLimitTexture;       // Number of samples to process for every pixel, see _useEarlyRayTermination
+
+        std::vector<float> cpuOutput;
+        std::vector<float> skipPositions;
+        std::vector<float> positionData;        // Normalized reduced positions, the same for every batch of a render
+        std::vector<float> meanPositions;
+        std::vector<int> mappingSampleStart;
+        std::vector<int> sampleLimits;          // CPU copy of the sample limit texture, used to size the batches
+    };
+
+    // Totals of the kNN searches of one full data render, reported once when the render completes instead of for every batch
+    struct FullDataSearchStats {
+        int64_t queries = 0;
+        double seconds = 0.0;
+        int64_t coldQueries = 0;                // Ray coherent search: queries that started from the entry point of the index
+        int64_t warmQueries = 0;                // Ray coherent search: queries that started from the neighbours of the previous sample
+        int64_t coldDistanceComputations = 0;
+        int64_t warmDistanceComputations = 0;
+        int64_t skipSamples = 0;                // Voxel embedding skip: samples that were checked
+        int64_t skippedSamples = 0;             // Voxel embedding skip: samples that took the position of their nearest voxel
+    };
+
+    struct RayCacheEntry {
+        int pixelIndex = -1;                // Pixel the ray was computed for
+        std::vector<float> meanPositions;   // Two floats per sample, the same layout as the output of batchSearch
+        uint32_t lastUsedRender = 0;        // The full data render in which the entry was last hit or stored, used for eviction
+        bool complete = true;               // False when the ray was cut off by the early ray termination, it can then only be reused by rays that need fewer samples
+    };
+
 private:
     void renderDirections();
     void renderTexture(mv::Texture2D& texture);
     void updateMatrices();
+    void updateFrameState(); // Uploads the state shared by all programs (matrices, clipping planes, volume size, step size, ...) to the FrameState uniform buffer
+
+    std::vector<CachedShaderProgram*> getRenderModeShaders(RenderMode mode);
+    bool loadRenderModeShaders(RenderMode mode);
+    bool loadFullDataComputeShaders();
 
-    void drawDVRRender(mv::ShaderProgram& shader);
-    void drawDVRQuad(mv::ShaderProgram& shader);
+    void drawDVRRender(CachedShaderProgram& shader);
+    void drawDVRQuad(CachedShaderProgram& shader);
 
     // Full data render mode methods
     void prepareANN();
-    void batchSearch(const std::vector<float>& queryData, std::vector<float>& positionData, uint32_t dimensions, int k, bool useWeightedMean, std::vector<float>& meanPositionData);
+    void buildANNIndex(const std::vector<float>& voxelData, uint32_t numVoxels, uint32_t dimensions);
+    ANNBackend selectANNBackend(uint32_t numVoxels, uint32_t dimensions, double expectedQueries) const;
+    double estimateFullDataQueries() const;
+    const char* getANNBackendName() const;
+#ifdef DVR_ANN_BENCHMARK
+    void benchmarkANNBackends(const std::vector<float>& voxelData, uint32_t numVoxels, uint32_t dimensions);
+#endif
+    void cancelANNBuild();
+    void batchSearch(const std::vector<float>& queryData, std::vector<float>& positionData, uint32_t dimensions, int k, bool useWeightedMean, std::vector<float>& meanPositionData, const std::vector<int>* rayStartIndices = nullptr);
+    void searchHNSWFromSeeds(const void* query, std::vector<hnswlib::tableint>& seeds, int k, std::vector<std::pair<float, int64_t>>& answers, size_t& distanceComputations) const;
     void getFacesTextureData(std::vector<float>& frontfacesData, std::vector<float>& backfacesData);
     void getGPUFullDataModeBatches(std::vector<float>& frontfacesData, std::vector<float>& backfacesData);
-    void retrieveBatchFullData(std::vector<float>& cpuOutput, int batchIndex, bool deleteBuffers);
-    void renderBatchToScreen(int batchIndex, uint32_t sampleDim, std::vector<float>& meanPositions);
+    void retrieveBatchFullData(std::vector<float>& cpuOutput, int batchIndex, bool deleteBuffers, bool readBack = true, std::vector<float>* skipPositions = nullptr);
+    void dispatchSampling(int batchIndex, bool embeddingSkip);
+    QOpenGLShaderProgram* loadSamplingShader(int raysPerGroup, int sampleThreads);
+#ifdef DVR_SAMPLING_BENCHMARK
+    void benchmarkSamplingWorkGroups(int batchIndex, bool embeddingSkip);
+#endif
+    void uploadVoxelEmbedding(const std::vector<float>& positionData);
+    void estimateRaySampleLimits();
+    void reportFullDataSearchStats() const;
+    void batchSearchWithVoxelSkip(const std::vector<float>& queryData, const std::vector<float>& skipPositions, std::vector<float>& positionData, uint32_t dimensions, int k, bool useWeightedMean, std::vector<float>& meanPositionData, const std::vector<int>& rayStartIndices);
+    void reserveArenaBuffer(FullDataArena::Buffer& buffer, size_t bytes);
+    void uploadArenaBuffer(FullDataArena::Buffer& buffer, const void* data, size_t bytes, GLuint binding);
+    void releaseFullDataArena();
+    void uploadCodebook(const std::vector<float>& positionData);
+    bool useGPUCodebookLookup() const;
+    GLuint lookupCodebookOnGPU(size_t numSamples, uint32_t sampleDim);
+    void compositeBatchToScreen(const std::vector<int>& pixelIndices, const std::vector<int>& rayStartIndices, size_t numSamples, GLuint meanPositionsBuffer);
+    void renderBatchToScreen(const std::vector<int>& pixelIndices, const std::vector<int>& rayStartIndices, uint32_t sampleDim, std::vector<float>& meanPositions);
+    RayCacheKey getRayCacheKey(const mv::Vector3f& absFront, const mv::Vector3f& absBack) const;
+    void updateRayCacheSettings();
+    void storeBatchInRayCache(int batchIndex, const std::vector<float>& meanPositions);
+    void invalidateRayCache();
     QVector2D ComputeMeanOfNN(const std::vector<std::pair<float, int64_t>>& neighbors, int k, const std::vector<float>& positionData);
+    template<int K>
+    QVector2D computeMeanOfNN(const float* distances, const int64_t* labels, int count, const std::vector<float>& positionData) const;
+    QVector2D meanOfNearestNeighbours(const float* distances, const int64_t* labels, int count, int k, const std::vector<float>& positionData);
     void updateRenderModeParameters();
 
     void renderFullData();
@@ -143,6 +288,16 @@ private:
 
     void normalizePositionData(std::vector<float>& positionData);
 
+    // Textures that the transfer function widget shares through its datasets (see SharedTextureCompositor in that plugin)
+    enum class SharedTextureState {
+        Unavailable,    // No shared texture, or its context does not share with ours: use the dataset data
+        Unchanged,      // The texture already holds this version, the event only announced the dataset data catching up
+        Updated         // The shared texture was copied into the target texture
+    };
+    SharedTextureState updateFromSharedTexture(const mv::Dataset<Images>& dataset, mv::Texture2D& target, GLenum internalFormat, quint64& version, int droppedRows = 0);
+    void ensureTfImage();                   // Reads the transfer function texture back into _tfImage when it came from a shared texture
+    void ensureMaterialPositionImage();     // Reads the material position texture back into _materialPositionImage when it came from a shared texture
+
     void updateRenderCubes();
 
 private:
@@ -150,17 +305,28 @@ private:
     int                         _mipDimension;
     std::vector<std::uint32_t>  _compositeIndices;
 
-    mv::ShaderProgram _surfaceShader;
-    mv::ShaderProgram _textureShader;
-    mv::ShaderProgram _2DCompositeShader;
-    mv::ShaderProgram _colorCompositeShader;
-    mv::ShaderProgram _1DMipShader;
-    mv::ShaderProgram _materialTransition2DShader;
-    mv::ShaderProgram _nnMaterialTransitionShader;
-    mv::ShaderProgram _altNNMaterialTransitionShader;
-    mv::ShaderProgram _fullDataCompositeShader;
-    mv::ShaderProgram _fullDataMaterialTransitionShader;
-    QOpenGLShaderProgram* _fullDataSamplerComputeShader; // This has a different type since mv::ShaderProgram does not support compute shaders
+    CachedShaderProgram _surfaceShader;
+    CachedShaderProgram _textureShader;
+    CachedShaderProgram _2DCompositeShader;
+    CachedShaderProgram _colorCompositeShader;
+    CachedShaderProgram _1DMipShader;
+    CachedShaderProgram _materialTransition2DShader;
+    CachedShaderProgram _nnMaterialTransitionShader;
+    CachedShaderProgram _altNNMaterialTransitionShader;
+    CachedShaderProgram _fullDataCompositeShader;
+    CachedShaderProgram _fullDataMaterialTransitionShader;
+    QOpenGLShaderProgram* _fullDataSamplerComputeShader = nullptr; // Compute shaders use QOpenGLShaderProgram directly, their binaries are cached as well (see loadCachedComputeShader)
+    int _samplingRaysPerGroup = 4;                      // Work group shape of the sampling shader: rays per group
+    int _samplingThreadsPerRay = 16;                    // and threads per ray (see loadSamplingShader)
+#ifdef DVR_SAMPLING_BENCHMARK
+    bool _samplingBenchmarkDone = false;
+#endif
+    QOpenGLShaderProgram* _codebookLookupComputeShader = nullptr;
+    QOpenGLShaderProgram* _rayIDScatterComputeShader = nullptr;
+    QOpenGLShaderProgram* _opacityEstimateComputeShader = nullptr;
+    bool _fullDataComputeShadersLoaded = false;         // The compute shaders are only loaded when a full data mode is used (or warmed up)
+    bool _fullDataComputeShadersValid = false;          // Result of that single load, true when all compute shaders linked
+    bool _useShaderWarmUp = false;                      // Link the shader programs of the other render modes in the background (see warmUpNextShader), off by default as it undoes the lazy loading and its lower driver memory
 
     mv::Vector3f _minClippingPlane;
     mv::Vector3f _maxClippingPlane;
@@ -176,7 +342,10 @@ private:
     bool _useCustomRenderSpace = false;
     bool _useClutterRemover = false; // only works for a few render modes, such as the NNMaterialTransition renderMode
     bool _useShading = false;
-    bool _ANNAlgorithmTrained = false; 
+    // Set by the worker thread (release) once the ANN index is ready to be searched. While it is false the worker owns the index members
+    // (_hnswIndex, _hnswSpace, _quantizedSpace, _rerankVectors, _bruteForceIndex, _codebook and the Faiss indices), they are only read
+    // after isANNIndexReady() returned true (acquire), and only written again after cancelANNBuild() has joined the worker.
+    std::atomic<bool> _ANNAlgorithmTrained = false;
 
     // (WIP) Originally this was used for empty space skipping, but it wasn't fully implemented and now this part is left in solly for the purpose having the camera kind of work inside the volume
     int _renderCubeSize = 20;
@@ -193,6 +362,8 @@ private:
     mv::Texture2D _materialPositionTexture;     //2D texture containing the material position texture
     mv::Texture3D _volumeTexture;               //3D texture containing the volume data
 
+    mv::Texture3D _voxelEmbeddingTexture;       // Normalized 2D embedding position of every voxel, used to skip the kNN search for samples close to a voxel and for the opacity pre-pass
+
     mv::Texture3D _tempNNMaterialVolume; // Temporary texture used for the NN material transition rendering, it is used to store the material volume data that is used to clean up noisy material transitions
 
     // IDs for the render cube buffers
@@ -204,11 +375,12 @@ private:
     // Create and bind the Marching cubes SSBOs
     GLuint edgeTableSSBO, triTableSSBO;
 
-    //Large GPU buffers for the full data mode
-    GLuint _indicesSSBO;
-    GLuint _startIndexSSBO;
-    GLuint _outputDataSSBO;
-    bool _GPUFullDataModeBuffersInitialized = false;
+    // Uniform buffer with the FrameState block, bound to CachedShaderProgram::FrameStateBinding
+    GLuint _frameStateUBO = 0;
+
+    //Large GPU buffers, scratch textures and CPU storage for the full data mode
+    FullDataArena _fullDataArena;
+    FullDataSearchStats _fullDataSearchStats;
 
     mv::Framebuffer _framebuffer;
     GLuint _defaultFramebuffer;
@@ -231,21 +403,38 @@ private:
     QPair<float, float> _scalarImageDataRange;
     QVector<float> _tfImage;                        // storage for the transfer function data
     QVector<float> _materialPositionImage;          // storage for the material transfer function data
+    bool _tfImageStale = false;                     // _tfImage is older than _tfTexture, which was copied from a shared texture
+    bool _materialPositionImageStale = false;       // _materialPositionImage is older than _materialPositionTexture
+    quint64 _tfTextureVersion = 0;                  // Version of the shared transfer function texture in _tfTexture, 0 when it came from the dataset
+    quint64 _materialPositionTextureVersion = 0;    // Version of the shared material position texture in _materialPositionTexture
+    quint64 _materialTransitionVersion = 0;         // Version of the material table in _materialTransitionTexture, 0 when the table is not versioned
     std::vector<float> _textureData;                // Storage for the volume data, currently used as a temporary storage for the volume data that is loaded into the texture (The fullDataRenderMode will use it for some auxiliary data so it won't reliably actually contain the current value there)
     float _stepSize = 0.5f;
     mv::Vector3f _cameraPos;
 
     size_t _fullDataMemorySize = 0; // The size of the full data in bytes
+    size_t _voxelEmbeddingMemorySize = 0; // The size of _voxelEmbeddingTexture in bytes, counted in the GPU memory budget of the full data batches
+    bool _voxelEmbeddingStale = true; // Set when the volume or the reduced positions change, the voxel embedding texture is then uploaded by the next full data render
+    int _voxelEmbeddingPositionTextureSize = 0; // Size of the position texture the voxel embedding was normalized for
     size_t _fullGPUMemorySize = static_cast<size_t>(2 * 1024 * 1024) * 1024; // The size of the full data in bytes on the GPU if we use normal int it causes a overflow; The SSBOs are limited to 2GB, so even if the GPU has more VRAM we limit the size to 2GB for the full data mode.
 
     // ANN-related members  
     std::string _hnswIndexFolder = "C:/hnsw_index/";
-    std::unique_ptr<hnswlib::L2Space> _hnswSpace;
+    std::unique_ptr<hnswlib::SpaceInterface<float>> _hnswSpace;
     std::unique_ptr<hnswlib::HierarchicalNSW<float>> _hnswIndex;
 
     int _hnswM = 16;
     int _hnswEfConstruction = 32;
     int _hwnsEfSearch = 8;
+    bool _useRayCoherentSearch = false; // Seed the HNSW search of every sample with the neighbours of the previous sample on the same ray (approximate, may return other neighbours than a cold search)
+
+    // int8 scalar quantization of the HNSW index, cuts the vector storage of the index by 4x
+    bool _useQuantizedANN = false;
+    // The quantized search returns k * factor candidates which are re-ranked on the original vectors. The re-ranking keeps the float vectors
+    // in memory next to the index, which costs more than the quantization saves, so it is off (1) by default.
+    int _quantizedRerankFactor = 1;
+    ScalarQuantizedL2Space* _quantizedSpace = nullptr;  // Points to _hnswSpace when the quantized index is used
+    std::vector<float> _rerankVectors;                  // Original vectors for the re-ranking, the vectors the index was built from (moved, not copied)
 
 #ifdef USE_FAISS
     std::unique_ptr<faiss::IndexIVFFlat> _faissIndexIVF;
@@ -256,6 +445,37 @@ private:
 
     // Boolean to select ANN library
     bool _useFaissANN = false;
+
+    // Exact search backend, picked automatically (see selectANNBackend) when the volume is small enough
+    ANNBackend _annBackend = ANNBackend::HNSW;  // Only written on the GUI thread in prepareANN, before the worker thread is started
+    BruteForceKnn _bruteForceIndex;
+    size_t _bruteForceMaxElements = static_cast<size_t>(1) << 20; // Maximum number of voxels * channels for which the exact search is considered at all
+    double _bruteForceSpeedup = 8.0;                                // Distance computations of the blocked SIMD exact search per distance computation of the HNSW graph search
+
+    // Samples that lie close to their nearest voxel take the embedding position of that voxel instead of going through the kNN search
+    bool _useVoxelEmbeddingSkip = false;
+    float _voxelEmbeddingSkipTolerance = 0.01f;         // Maximum distance between a sample and its nearest voxel, relative to the length of the voxel vector (0 only skips exact matches)
+
+    // Early ray termination: an opacity pre-pass on the voxel embedding positions finds where every ray becomes opaque, the samples behind that point are not sampled, read back or searched
+    bool _useEarlyRayTermination = true;
+    float _earlyTerminationAlpha = 0.99f;               // Estimated opacity at which a ray is cut off
+    int _earlyTerminationMarginSamples = 8;             // Samples that are kept behind the cut off point, the estimate uses the nearest voxel instead of the kNN result
+
+    // Codebook backend: the samples are mapped to the position of their nearest k-means centroid, on the GPU (or on the CPU with bit-identical results)
+    bool _useCodebookSearch = false;
+    bool _useGPUCodebookLookup = true;                  // False maps the samples on the CPU after reading them back, like the other backends
+    int _codebookSize = 256;                            // Number of centroids
+    int _codebookIterations = 20;                       // Maximum number of k-means iterations
+    KMeansCodebook _codebook;
+    std::vector<float> _codebookPositions;              // Normalized embedding position of every centroid, updated at the start of every full data render
+    GLuint _codebookCentroidsSSBO = 0;
+    GLuint _codebookPositionsSSBO = 0;
+    static constexpr uint32_t _codebookLookupTileFloats = 4096; // Size of the centroid tile of FullDataCodebookLookup.comp, samples with more channels are mapped on the CPU
+
+    // Background construction of the ANN index, the full data modes wait for it to finish
+    std::future<void> _annBuildTask;
+    std::atomic<bool> _annBuildCancelled = false;
+    bool _annBuildFailed = false;                       // Set when a build finished without an index, cleared when the data or the channels change
     
     // Full Data Rendermode Parameters
     std::vector<std::vector<int>> _GPUBatches; // Batches of pixel indices for the full data mode as it is not always possible to fit all pixels in one batch
@@ -263,6 +483,23 @@ private:
     std::vector<size_t> _subsetsMemory; // Total memory per batch.
     int _fullDataModeBatch = -1; // The batch index of the full data mode that is currently being processed
 
+    // Cross-frame reuse of the full data results: rays whose quantized entry and exit points were already computed in an earlier render skip the sampling and the kNN search
+    bool _useRayCache = true;
+    // Size of a quantization step of the ray entry and exit points, in voxels. A reused ray is at most one step away from the exact one,
+    // a rotation by an angle a moves a point at distance r (in voxels) from the centre by about r * a, so at the surface of a 256^3 volume
+    // (r ~ 128) the rays are reused for rotations up to about 0.45 degrees.
+    float _rayCacheQuantization = 1.0f;
+    size_t _rayCacheMaxBytes = static_cast<size_t>(512) * 1024 * 1024;          // Entries that were not used in the current render are evicted when the cache grows beyond this size
+    size_t _rayCacheBytes = 0;
+    uint32_t _rayCacheRender = 0;                                               // Counts the full data renders, to find the entries that are not visible anymore
+    std::unordered_map<RayCacheKey, std::vector<RayCacheEntry>, RayCacheKeyHash> _rayCache;  // One entry per pixel whose ray falls in the cells of the key
+    std::vector<float> _rayCacheSettings;                                       // The settings the cached results were computed with, the cache is cleared when they change
+    std::vector<std::vector<RayCacheKey>> _GPUBatchesRayKeys;                   // Cache key of every ray in _GPUBatches
+    std::vector<std::vector<bool>> _GPUBatchesRayComplete;                      // Whether every ray in _GPUBatches is sampled up to its back face
+    std::vector<int> _cachedRayPixels;                                          // Pixel indices of the rays of the current render that were found in the cache
+    std::vector<int> _cachedRayStartIndex;                                      // Start sample of every cached ray in _cachedRayMeanPositions
+    std::vector<float> _cachedRayMeanPositions;                                 // The cached results of these rays, rendered before the first GPU batch
+
     // Marching cubes tables (for smoothing in NN modes)
     int* edgeTable = MarchingCubes::getEdgeTable();
     int* triTable = MarchingCubes::getTriTable();